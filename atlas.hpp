@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include "buffer.hpp"
+#include "texture.hpp"
+
+// Packs glyph bitmaps into single channel textures. Glyphs are placed on
+// shelves (rows as tall as their tallest glyph); when a page is full a new
+// page is started, so a string usually needs one texture only. A glyph that
+// can't fit even an empty page is rejected.
+class GlyphAtlas {
+public:
+  static constexpr int pageSize = 1024;
+  static constexpr int padding = 1;
+
+  struct Region {
+    size_t page = 0;
+    glm::vec4 uvRect{0, 0, 0, 0}; // left, top, right, bottom
+    bool placed = false;
+  };
+
+  Region insert(int width, int height, const unsigned char *pixels,
+                int pitch) {
+    if (width + 2 * padding > pageSize || height + 2 * padding > pageSize) {
+      std::cerr << "glyph of " << width << "x" << height
+                << " pixels doesn't fit a " << pageSize << "x" << pageSize
+                << " atlas page, skipped" << std::endl;
+      return {};
+    }
+    if (pages.empty() || !fits(*pages.back(), width, height)) {
+      addPage();
+    }
+    auto &page = *pages.back();
+
+    if (page.shelfX + width + padding > pageSize) {
+      page.shelfY += page.shelfHeight + padding;
+      page.shelfX = 0;
+      page.shelfHeight = 0;
+    }
+
+    auto x = page.shelfX + padding;
+    auto y = page.shelfY + padding;
+
+    page.texture.pixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    page.texture.pixelStorei(GL_UNPACK_ROW_LENGTH, pitch);
+    page.texture.textureSubImage2D(0, x, y, width, height, GL_RED,
+                                   GL_UNSIGNED_BYTE, pixels);
+    page.texture.pixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    UploadStats::record(static_cast<size_t>(width) * height);
+
+    page.shelfX = x + width;
+    if (height > page.shelfHeight) {
+      page.shelfHeight = height;
+    }
+
+    Region region;
+    region.page = pages.size() - 1;
+    region.placed = true;
+    region.uvRect = glm::vec4{static_cast<float>(x) / pageSize,
+                              static_cast<float>(y) / pageSize,
+                              static_cast<float>(x + width) / pageSize,
+                              static_cast<float>(y + height) / pageSize};
+    return region;
+  }
+
+  Texture &getPage(size_t page) { return pages[page]->texture; }
+  size_t pageCount() const { return pages.size(); }
+
+private:
+  struct Page {
+    Page() : texture{GL_TEXTURE_2D} {}
+
+    Texture texture;
+    int shelfX = 0, shelfY = 0, shelfHeight = 0;
+  };
+
+  static bool fits(const Page &page, int width, int height) {
+    auto shelfY = page.shelfY;
+    auto shelfHeight = page.shelfHeight;
+    if (page.shelfX + width + padding > pageSize) {
+      shelfY += shelfHeight + padding;
+      shelfHeight = 0;
+    }
+    return shelfY + padding + height + padding <= pageSize;
+  }
+
+  void addPage() {
+    auto &page = *pages.emplace_back(std::make_unique<Page>());
+    auto &texture = page.texture;
+
+    texture.textureStorage2D(1, GL_R8, pageSize, pageSize);
+    unsigned char zero = 0;
+    texture.clearTexImage(0, GL_RED, GL_UNSIGNED_BYTE, &zero);
+
+    texture.textureParameteri(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    texture.textureParameteri(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    texture.textureParameteri(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    texture.textureParameteri(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  }
+
+  std::vector<std::unique_ptr<Page>> pages;
+};
@@ -0,0 +1,425 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "simulation.hpp"
+
+// Steps many Sim::Match equivalents at once. Every field lives in its own
+// array (structure of arrays) and each block of `lanes` matches is stepped
+// with branch-free mask blends only, so the compiler turns the inner loop
+// into SIMD compares and blends. Given the same seed and inputs, a lane
+// produces exactly the same states as Sim::Match.
+
+namespace Sim {
+
+class Batch {
+public:
+  static constexpr size_t lanes = 8;
+
+  struct Columns {
+    std::vector<float> ballX, ballY, ballSpeedX, ballSpeedY;
+    std::vector<float> rPaddleY, lPaddleY;
+    std::vector<int32_t> rMoving, lMoving;
+    std::vector<int32_t> gameState;
+    std::vector<int32_t> rScore, lScore;
+    std::vector<uint32_t> rng;
+  };
+
+  Batch(size_t size, float aspect, uint32_t seed = 1, Config config = {})
+      : count{size}, config{config}, aspect{aspect} {
+    auto padded = (size + lanes - 1) / lanes * lanes;
+    for (auto *column :
+         {&columns.ballX, &columns.ballY, &columns.ballSpeedX,
+          &columns.ballSpeedY, &columns.rPaddleY, &columns.lPaddleY}) {
+      column->resize(padded);
+    }
+    for (auto *column : {&columns.rMoving, &columns.lMoving, &columns.gameState,
+                         &columns.rScore, &columns.lScore}) {
+      column->resize(padded);
+    }
+    columns.rng.resize(padded);
+
+    for (size_t i = 0; i < padded; i++) {
+      reset(i, seedFor(seed, i));
+    }
+  }
+
+  // Puts one match back into Sim::Match's freshly constructed state.
+  void reset(size_t index, uint32_t seed) {
+    columns.ballX[index] = 0;
+    columns.ballY[index] = 0;
+    columns.ballSpeedX[index] = config.ballSpeed;
+    columns.ballSpeedY[index] = 0;
+    columns.rPaddleY[index] = 0;
+    columns.lPaddleY[index] = 0;
+    columns.rMoving[index] = 0;
+    columns.lMoving[index] = 0;
+    columns.gameState[index] = static_cast<int32_t>(GameState::beginGame);
+    columns.rScore[index] = 0;
+    columns.lScore[index] = 0;
+    columns.rng[index] = seed != 0 ? seed : 1;
+  }
+
+  // inputs holds one InputBits mask per match.
+  void step(std::span<const uint8_t> inputs) {
+    for (size_t base = 0; base < count; base += lanes) {
+      Block block;
+      load(block, base);
+
+      auto n = std::min(lanes, count - base);
+      std::fill(std::begin(block.input), std::end(block.input), 0);
+      for (size_t i = 0; i < n; i++) {
+        block.input[i] = inputs[base + i];
+      }
+
+      stepBlock(block);
+      store(block, base);
+    }
+  }
+
+  void setAspect(float newAspect) { aspect = newAspect; }
+
+  // Gathers one lane back into the Sim::Match layout.
+  State getState(size_t index) const {
+    State state{};
+    state.gameState = static_cast<GameState>(columns.gameState[index]);
+    state.ball = {columns.ballX[index], columns.ballY[index],
+                  columns.ballSpeedX[index], columns.ballSpeedY[index]};
+    state.rPaddle = {config.paddleMargin * aspect, columns.rPaddleY[index],
+                     columns.rMoving[index] != 0};
+    state.lPaddle = {-config.paddleMargin * aspect, columns.lPaddleY[index],
+                     columns.lMoving[index] != 0};
+    state.rScore = columns.rScore[index];
+    state.lScore = columns.lScore[index];
+    state.rng = columns.rng[index];
+    return state;
+  }
+
+  const Columns &getColumns() const { return columns; }
+  const Config &getConfig() const { return config; }
+  size_t size() const { return count; }
+
+  static uint32_t seedFor(uint32_t seed, size_t index) {
+    uint32_t s = seed + static_cast<uint32_t>(index) * 0x9E3779B9u;
+    return s != 0 ? s : 1;
+  }
+
+private:
+  struct Block {
+    float ballX[lanes], ballY[lanes], ballSpeedX[lanes], ballSpeedY[lanes];
+    float rPaddleY[lanes], lPaddleY[lanes];
+    int32_t rMoving[lanes], lMoving[lanes];
+    int32_t gameState[lanes];
+    int32_t rScore[lanes], lScore[lanes];
+    uint32_t rng[lanes];
+    int32_t input[lanes];
+
+    // carried between the phases of stepBlock
+    uint32_t fly[lanes];
+    float left[lanes];
+  };
+
+  void load(Block &block, size_t base) const {
+    std::copy_n(&columns.ballX[base], lanes, block.ballX);
+    std::copy_n(&columns.ballY[base], lanes, block.ballY);
+    std::copy_n(&columns.ballSpeedX[base], lanes, block.ballSpeedX);
+    std::copy_n(&columns.ballSpeedY[base], lanes, block.ballSpeedY);
+    std::copy_n(&columns.rPaddleY[base], lanes, block.rPaddleY);
+    std::copy_n(&columns.lPaddleY[base], lanes, block.lPaddleY);
+    std::copy_n(&columns.rMoving[base], lanes, block.rMoving);
+    std::copy_n(&columns.lMoving[base], lanes, block.lMoving);
+    std::copy_n(&columns.gameState[base], lanes, block.gameState);
+    std::copy_n(&columns.rScore[base], lanes, block.rScore);
+    std::copy_n(&columns.lScore[base], lanes, block.lScore);
+    std::copy_n(&columns.rng[base], lanes, block.rng);
+  }
+
+  void store(const Block &block, size_t base) {
+    std::copy_n(block.ballX, lanes, &columns.ballX[base]);
+    std::copy_n(block.ballY, lanes, &columns.ballY[base]);
+    std::copy_n(block.ballSpeedX, lanes, &columns.ballSpeedX[base]);
+    std::copy_n(block.ballSpeedY, lanes, &columns.ballSpeedY[base]);
+    std::copy_n(block.rPaddleY, lanes, &columns.rPaddleY[base]);
+    std::copy_n(block.lPaddleY, lanes, &columns.lPaddleY[base]);
+    std::copy_n(block.rMoving, lanes, &columns.rMoving[base]);
+    std::copy_n(block.lMoving, lanes, &columns.lMoving[base]);
+    std::copy_n(block.gameState, lanes, &columns.gameState[base]);
+    std::copy_n(block.rScore, lanes, &columns.rScore[base]);
+    std::copy_n(block.lScore, lanes, &columns.lScore[base]);
+    std::copy_n(block.rng, lanes, &columns.rng[base]);
+  }
+
+  static uint32_t xorshift(uint32_t rng) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+  }
+
+  // Same mapping as Sim::getRandomf.
+  static float unitFloat(uint32_t rng) {
+    return static_cast<float>(static_cast<int32_t>(rng >> 8)) /
+           static_cast<float>(1 << 24);
+  }
+
+  // Blends are written as bit operations on all-ones/all-zeros masks. A
+  // ternary would let the optimizer thread the mutually exclusive state tests
+  // back into branches, which stops the loop from vectorizing.
+  static uint32_t mask(bool condition) { return 0u - uint32_t(condition); }
+
+  static uint32_t select(uint32_t m, uint32_t a, uint32_t b) {
+    return (a & m) | (b & ~m);
+  }
+
+  static int32_t select(uint32_t m, int32_t a, int32_t b) {
+    return static_cast<int32_t>(
+        select(m, static_cast<uint32_t>(a), static_cast<uint32_t>(b)));
+  }
+
+  static float select(uint32_t m, float a, float b) {
+    return std::bit_cast<float>(
+        select(m, std::bit_cast<uint32_t>(a), std::bit_cast<uint32_t>(b)));
+  }
+
+  static float maxf(float a, float b) { return select(mask(a < b), b, a); }
+  static float minf(float a, float b) { return select(mask(b < a), b, a); }
+
+  // The three phases mirror Sim::Match: serve or keep flying, sweep the ball
+  // through the tick, then move paddles and resolve the game state. Each is
+  // its own loop over the lanes so every loop stays vectorizable.
+  void stepBlock(Block &b) const {
+    launchBall(b);
+    for (int k = 0; k < config.maxBounces; k++) {
+      sweepBall(b);
+    }
+    resolveState(b);
+  }
+
+  void launchBall(Block &b) const {
+    using enum GameState;
+
+    const float dt = config.getTickDuration();
+    const float ballSpeed = config.ballSpeed;
+
+    for (size_t i = 0; i < lanes; i++) {
+      const int32_t gs = b.gameState[i];
+      const uint32_t isBegin = mask(gs == int32_t(beginGame));
+      const uint32_t isPlaying = mask(gs == int32_t(gamePlaying));
+      const uint32_t space = mask((b.input[i] & spaceBit) != 0);
+
+      // serve from the center
+      const uint32_t launch = isBegin & space;
+      uint32_t rng = b.rng[i];
+      const uint32_t next = xorshift(rng);
+      const float direction = 0 + (2.0f - 0) * unitFloat(next);
+      b.rng[i] = select(launch, next, rng);
+      b.ballSpeedX[i] =
+          select(launch, select(mask(direction > 1.0f), ballSpeed, -ballSpeed),
+                 b.ballSpeedX[i]);
+      b.ballSpeedY[i] = select(launch, 0.0f, b.ballSpeedY[i]);
+      b.ballX[i] = select(launch, 0.0f, b.ballX[i]);
+      b.ballY[i] = select(launch, 0.0f, b.ballY[i]);
+
+      b.fly[i] = isPlaying | launch;
+      b.left[i] = dt;
+    }
+  }
+
+  // One iteration of Sim::Match::sweepBall for every flying lane.
+  void sweepBall(Block &b) const {
+    const float inf = std::numeric_limits<float>::infinity();
+    const float halfWidth = config.ballWidth / 2;
+    const float halfPaddleWidth = config.paddleWidth / 2;
+    const float halfPaddleHeight = config.paddleHeight / 2;
+    const float rx = config.paddleMargin * aspect;
+    const float lx = -config.paddleMargin * aspect;
+    const float spinMin = -config.spin;
+    const float spinRange = config.spin - spinMin;
+
+    for (size_t i = 0; i < lanes; i++) {
+      const uint32_t fly = b.fly[i];
+      float bx = b.ballX[i], by = b.ballY[i];
+      float sx = b.ballSpeedX[i], sy = b.ballSpeedY[i];
+      float left = b.left[i];
+      uint32_t rng = b.rng[i];
+
+      const uint32_t up = mask(sy > 0.0f);
+      const uint32_t down = mask(sy < 0.0f);
+      const uint32_t still = ~(up | down);
+
+      // walls
+      float best = left;
+      int32_t kind = 0; // 0 none, 1 wall, 2 left paddle, 3 right paddle
+      uint32_t xFace = 0;
+
+      const float tTop = maxf((1 - halfWidth - by) / sy, 0.0f);
+      uint32_t m = up & mask(tTop <= left) & mask(tTop < best);
+      best = select(m, tTop, best);
+      kind = select(m, 1, kind);
+
+      const float tBottom = maxf((-1 + halfWidth - by) / sy, 0.0f);
+      m = down & mask(tBottom <= left) & mask(tBottom < best);
+      best = select(m, tBottom, best);
+      kind = select(m, 1, kind);
+
+      // paddles, as in Sim::Match::sweepPaddle
+      auto sweepPaddle = [&](float py, uint32_t toward,
+                             float nearX, float farX, int32_t id) {
+        const float y0 = py - halfPaddleHeight - halfWidth;
+        const float y1 = py + halfPaddleHeight + halfWidth;
+        const float xEntry = (nearX - bx) / sx;
+        const float xExit = (farX - bx) / sx;
+
+        const float a = (y0 - by) / sy;
+        const float c = (y1 - by) / sy;
+        const uint32_t inside = mask(y0 < by) & mask(by < y1);
+        float yEntry = select(up, a, c);
+        float yExit = select(up, c, a);
+        yEntry = select(still, select(inside, -inf, inf), yEntry);
+        yExit = select(still, select(inside, inf, -inf), yExit);
+
+        const float entry = maxf(xEntry, yEntry);
+        const float exit = minf(xExit, yExit);
+        const float time = maxf(entry, 0.0f);
+        const uint32_t hit = toward & mask(entry < exit) & mask(exit > 0.0f) &
+                             mask(entry <= left) & mask(time < best);
+        best = select(hit, time, best);
+        kind = select(hit, id, kind);
+        xFace = select(hit, mask(xEntry >= yEntry), xFace);
+      };
+      sweepPaddle(b.lPaddleY[i], mask(sx < 0.0f),
+                  lx + halfPaddleWidth + halfWidth,
+                  lx - halfPaddleWidth - halfWidth, 2);
+      sweepPaddle(b.rPaddleY[i], mask(sx > 0.0f),
+                  rx - halfPaddleWidth - halfWidth,
+                  rx + halfPaddleWidth + halfWidth, 3);
+
+      // advance to the impact and reflect
+      const uint32_t wall = mask(kind == 1);
+      const uint32_t hitL = mask(kind == 2);
+      const uint32_t hitR = mask(kind == 3);
+      const uint32_t spin = (hitL & mask(b.lMoving[i] != 0)) |
+                            (hitR & mask(b.rMoving[i] != 0));
+
+      bx += sx * best;
+      by += sy * best;
+      left -= best;
+
+      const uint32_t next = xorshift(rng);
+      sy = select(spin, sy + (spinMin + spinRange * unitFloat(next)), sy);
+      rng = select(spin, next, rng);
+      const uint32_t paddle = hitL | hitR;
+      sx = select(paddle & xFace, -sx, sx);
+      sy = select(wall | (paddle & ~xFace), -sy, sy);
+
+      b.ballX[i] = select(fly, bx, b.ballX[i]);
+      b.ballY[i] = select(fly, by, b.ballY[i]);
+      b.ballSpeedX[i] = select(fly, sx, b.ballSpeedX[i]);
+      b.ballSpeedY[i] = select(fly, sy, b.ballSpeedY[i]);
+      b.left[i] = select(fly, left, b.left[i]);
+      b.rng[i] = select(fly, rng, b.rng[i]);
+    }
+  }
+
+  void resolveState(Block &b) const {
+    using enum GameState;
+
+    const float halfPaddleHeight = config.paddleHeight / 2;
+    const float rx = config.paddleMargin * aspect;
+    const float lx = -config.paddleMargin * aspect;
+    const float ballSpeed = config.ballSpeed;
+    const float paddleStep = config.paddleSpeed * config.getTickDuration();
+
+    for (size_t i = 0; i < lanes; i++) {
+      const int32_t gs = b.gameState[i];
+      const int32_t input = b.input[i];
+      const uint32_t isBegin = mask(gs == int32_t(beginGame));
+      const uint32_t isPlaying = mask(gs == int32_t(gamePlaying));
+      const uint32_t isAttack = mask(gs == int32_t(attackPlayer));
+      const uint32_t isGoal = mask(gs == int32_t(goal));
+      const uint32_t isOver = mask(gs == int32_t(over));
+      const uint32_t space = mask((input & spaceBit) != 0);
+
+      float bx = b.ballX[i], by = b.ballY[i];
+      float sx = b.ballSpeedX[i], sy = b.ballSpeedY[i];
+      float ly = b.lPaddleY[i], ry = b.rPaddleY[i];
+
+      // paddles move in every state but over
+      const uint32_t active = ~isOver;
+      const uint32_t lu = active & mask((input & lUpBit) != 0) &
+                          mask(ly < 1 - halfPaddleHeight);
+      const uint32_t ld = active & ~lu & mask((input & lDownBit) != 0) &
+                          mask(ly > -1 + halfPaddleHeight);
+      const uint32_t ru = active & mask((input & rUpBit) != 0) &
+                          mask(ry < 1 - halfPaddleHeight);
+      const uint32_t rd = active & ~ru & mask((input & rDownBit) != 0) &
+                          mask(ry > -1 + halfPaddleHeight);
+      ly = select(lu, ly + paddleStep, select(ld, ly - paddleStep, ly));
+      ry = select(ru, ry + paddleStep, select(rd, ry - paddleStep, ry));
+      const int32_t lMoving =
+          select(active, int32_t((lu | ld) & 1), b.lMoving[i]);
+      const int32_t rMoving =
+          select(active, int32_t((ru | rd) & 1), b.rMoving[i]);
+
+      const uint32_t launch = isBegin & space;
+      const uint32_t scored = isPlaying & (mask(rx < bx) | mask(bx < lx));
+
+      // serve from the paddle of the player who conceded
+      const uint32_t attackL = isAttack & mask(bx < 0.0f);
+      const uint32_t attackR = isAttack & mask(0.0f < bx);
+      const uint32_t serve = (attackL | attackR) & space;
+      bx = select(attackL, lx + config.attackOffset,
+                  select(attackR, rx - config.attackOffset, bx));
+      by = select(attackL, ly, select(attackR, ry, by));
+      sx = select(serve, select(attackL, ballSpeed, -ballSpeed), sx);
+      sy = select(serve, 0.0f, sy);
+
+      // scoring
+      const int32_t rScore =
+          b.rScore[i] + int32_t(isGoal & mask(bx < 0.0f) & 1);
+      const int32_t lScore =
+          b.lScore[i] + int32_t(isGoal & mask(0.0f < bx) & 1);
+      const uint32_t matchOver = mask(lScore >= config.matchPoint) |
+                                 mask(rScore >= config.matchPoint);
+
+      // game over, space restarts
+      const uint32_t restart = isOver & space;
+      bx = select(isOver, 0.0f, bx);
+      by = select(isOver, 0.0f, by);
+
+      int32_t nextState = gs;
+      nextState = select(launch | serve | (isPlaying & ~scored),
+                         int32_t(gamePlaying), nextState);
+      nextState = select(scored, int32_t(goal), nextState);
+      nextState = select(
+          isGoal, select(matchOver, int32_t(over), int32_t(attackPlayer)),
+          nextState);
+      nextState = select(restart, int32_t(beginGame), nextState);
+
+      b.ballX[i] = bx;
+      b.ballY[i] = by;
+      b.ballSpeedX[i] = sx;
+      b.ballSpeedY[i] = sy;
+      b.lPaddleY[i] = ly;
+      b.rPaddleY[i] = ry;
+      b.lMoving[i] = lMoving;
+      b.rMoving[i] = rMoving;
+      b.gameState[i] = nextState;
+      b.rScore[i] = select(restart, 0, rScore);
+      b.lScore[i] = select(restart, 0, lScore);
+    }
+  }
+
+  size_t count;
+  Config config;
+  float aspect;
+  Columns columns;
+};
+
+} // namespace Sim
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+
+#include <GL/glew.h>
+
+#include <benchmark/benchmark.h>
+
+#include "../ft2wrap.hpp"
+#include "../window.hpp"
+#ifdef PONG_HEADLESS
+#include "../headless.hpp"
+#endif
+
+namespace Bench {
+
+inline const std::string fontPath{"../fonts/NotoSansJP-Bold.otf"};
+
+inline bool hasContext = false;
+
+#ifdef PONG_HEADLESS
+inline std::unique_ptr<Headless::Context> context;
+inline std::unique_ptr<Framebuffer> framebuffer;
+#endif
+
+// Surfaceless EGL context like the headless game's, so the GL benchmarks
+// need neither a display nor a GPU (Mesa falls back to llvmpipe). Builds
+// without EGL have no context and skip them.
+inline bool createContext() {
+#ifdef PONG_HEADLESS
+  context = std::make_unique<Headless::Context>();
+  if (!context->create()) {
+    context.reset();
+    return false;
+  }
+  if (glewContextInit() != GLEW_OK) {
+    std::cerr << "can't initialize glew" << std::endl;
+    return false;
+  }
+  Window::setSize(1080, 720);
+  framebuffer = std::make_unique<Framebuffer>(1080, 720);
+  framebuffer->bind();
+  Ft2Wrap::freetype2::init();
+
+  hasContext = true;
+  return true;
+#else
+  std::cerr << "built without EGL, skipping the GL benchmarks" << std::endl;
+  return false;
+#endif
+}
+
+inline bool requireContext(benchmark::State &state) {
+  if (!hasContext) {
+    state.SkipWithError("no GL context");
+  }
+  return hasContext;
+}
+
+} // namespace Bench
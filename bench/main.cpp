@@ -0,0 +1,18 @@
+#include <benchmark/benchmark.h>
+
+#include "bench.hpp"
+
+// Runs like any Google Benchmark binary, e.g.
+//   pong_bench --benchmark_out=bench.json --benchmark_out_format=json
+// Without a GL context the GL benchmarks are reported as skipped.
+int main(int argc, char **argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  Bench::createContext();
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
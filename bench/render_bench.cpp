@@ -0,0 +1,148 @@
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "../objects.hpp"
+#include "../simulation.hpp"
+#include "../string.hpp"
+#include "bench.hpp"
+
+// Everything here needs the context made by Bench::createContext().
+
+static void BM_BallUpdate(benchmark::State &state) {
+  if (!Bench::requireContext(state)) {
+    return;
+  }
+  Ball ball{0.15};
+  Sim::BallState ballState{0, 0, 1.2, 0.3};
+  for (auto _ : state) {
+    ballState.x += 0.001f; // a moving ball changes its quad every update
+    ball.update(ballState);
+  }
+}
+BENCHMARK(BM_BallUpdate);
+
+static void BM_PaddleUpdate(benchmark::State &state) {
+  if (!Bench::requireContext(state)) {
+    return;
+  }
+  Paddle paddle{0.1, 0.3, glm::vec3{0.2, 0.2, 0.2}};
+  Sim::PaddleState paddleState{0.9, 0, true};
+  for (auto _ : state) {
+    paddleState.y = paddleState.y > 0.8f ? -0.8f : paddleState.y + 0.01f;
+    paddle.update(paddleState);
+  }
+}
+BENCHMARK(BM_PaddleUpdate);
+
+// A whole tick as Pong runs it: step, interpolate, place the drawables and
+// mirror the scores.
+static void BM_TickUpdate(benchmark::State &state) {
+  if (!Bench::requireContext(state)) {
+    return;
+  }
+  Sim::Match match{Window::getAspect()};
+  auto &config = match.getConfig();
+  Ball ball{config.ballWidth};
+  Paddle rPaddle{config.paddleWidth, config.paddleHeight,
+                 glm::vec3{0.2, 0.2, 0.2}};
+  Paddle lPaddle{config.paddleWidth, config.paddleHeight,
+                 glm::vec3{0.2, 0.2, 0.2}};
+  String score{Bench::fontPath,          L"0",
+               Ft2Wrap::getPoint(10, 0), glm::vec3{0.2, 0.2, 0.2},
+               glm::vec2{-0.75, 0.8},    String::center};
+  Sim::Input input;
+  input.space = true;
+  for (auto _ : state) {
+    auto previous = match.getState();
+    match.step(input);
+    auto shown = Sim::interpolate(previous, match.getState(), 0.5f);
+    ball.update(shown.ball);
+    rPaddle.update(shown.rPaddle);
+    lPaddle.update(shown.lPaddle);
+    score.update(std::to_wstring(match.getState().lScore));
+  }
+}
+BENCHMARK(BM_TickUpdate);
+
+// Alternates between a short and a long text of range(0) characters.
+static void BM_StringGrowShrink(benchmark::State &state) {
+  if (!Bench::requireContext(state)) {
+    return;
+  }
+  std::wstring longText(state.range(0), L'8');
+  String text{Bench::fontPath,          L"0",
+              Ft2Wrap::getPoint(10, 0), glm::vec3{0.2, 0.2, 0.2},
+              glm::vec2{0, 0},          String::center};
+  for (auto _ : state) {
+    text.update(longText);
+    text.update(L"0");
+  }
+  state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_StringGrowShrink)->Arg(4)->Arg(32)->Arg(256);
+
+// Same length, different glyphs: no Character is added or removed, so this
+// is the glyph lookup and the horizontal layout.
+static void BM_StringLayout(benchmark::State &state) {
+  if (!Bench::requireContext(state)) {
+    return;
+  }
+  std::wstring a(state.range(0), L'1'), b(state.range(0), L'7');
+  String text{Bench::fontPath,          a,
+              Ft2Wrap::getPoint(10, 0), glm::vec3{0.2, 0.2, 0.2},
+              glm::vec2{0, 0},          String::center};
+  for (auto _ : state) {
+    text.update(b);
+    text.update(a);
+  }
+  state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_StringLayout)->Arg(4)->Arg(32)->Arg(256);
+
+// Glyphs come from the cache after the first iteration.
+static void BM_CharacterConstruct(benchmark::State &state) {
+  if (!Bench::requireContext(state)) {
+    return;
+  }
+  for (auto _ : state) {
+    Character c{Bench::fontPath, L'A', Ft2Wrap::getPoint(10, 0),
+                glm::vec2{0, 0}};
+    benchmark::DoNotOptimize(c);
+  }
+}
+BENCHMARK(BM_CharacterConstruct);
+
+// Contents change every iteration, so every assignment is uploaded.
+static void BM_ArrayBufferUpload(benchmark::State &state) {
+  if (!Bench::requireContext(state)) {
+    return;
+  }
+  auto size = static_cast<size_t>(state.range(0));
+  std::vector<glm::vec3> data(size, glm::vec3{0, 0, 0});
+  ArrayBuffer<glm::vec3> buffer{size};
+  float i = 0;
+  for (auto _ : state) {
+    data[0].x = i++;
+    buffer = std::span<glm::vec3>{data};
+  }
+  glFinish();
+  state.SetBytesProcessed(state.iterations() * size * sizeof(glm::vec3));
+}
+BENCHMARK(BM_ArrayBufferUpload)->RangeMultiplier(8)->Range(8, 32768);
+
+// Unchanged contents, which the CPU copy turns into a compare.
+static void BM_ArrayBufferUnchanged(benchmark::State &state) {
+  if (!Bench::requireContext(state)) {
+    return;
+  }
+  auto size = static_cast<size_t>(state.range(0));
+  std::vector<glm::vec3> data(size, glm::vec3{0, 0, 0});
+  ArrayBuffer<glm::vec3> buffer{size};
+  for (auto _ : state) {
+    buffer = std::span<glm::vec3>{data};
+  }
+  state.SetBytesProcessed(state.iterations() * size * sizeof(glm::vec3));
+}
+BENCHMARK(BM_ArrayBufferUnchanged)->RangeMultiplier(8)->Range(8, 32768);
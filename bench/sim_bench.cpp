@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "../batch.hpp"
+#include "../env.hpp"
+#include "../replay.hpp"
+#include "../simulation.hpp"
+
+// Inputs that serve often and move the paddles at random, so a run goes
+// through every game state.
+static std::vector<uint8_t> scriptedInputs(size_t count, uint32_t seed) {
+  std::vector<uint8_t> inputs(count);
+  for (auto &e : inputs) {
+    auto r = Sim::nextRandom(seed);
+    e = static_cast<uint8_t>(r & (Sim::rUpBit | Sim::rDownBit | Sim::lUpBit |
+                                  Sim::lDownBit));
+    if ((r >> 8) % 16 == 0) {
+      e |= Sim::spaceBit;
+    }
+  }
+  return inputs;
+}
+
+static void BM_MatchStep(benchmark::State &state) {
+  Sim::Match match{16.0f / 9.0f};
+  auto inputs = scriptedInputs(4096, 7);
+  size_t i = 0;
+  for (auto _ : state) {
+    match.step(Sim::unpackInput(inputs[i++ % inputs.size()]));
+    benchmark::DoNotOptimize(match.getState());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MatchStep);
+
+static bool operator==(const Sim::State &a, const Sim::State &b) {
+  auto samePaddle = [](const Sim::PaddleState &a, const Sim::PaddleState &b) {
+    return a.x == b.x && a.y == b.y && a.moving == b.moving;
+  };
+  return a.gameState == b.gameState && a.ball.x == b.ball.x &&
+         a.ball.y == b.ball.y && a.ball.speedX == b.ball.speedX &&
+         a.ball.speedY == b.ball.speedY && samePaddle(a.rPaddle, b.rPaddle) &&
+         samePaddle(a.lPaddle, b.lPaddle) && a.rScore == b.rScore &&
+         a.lScore == b.lScore && a.rng == b.rng;
+}
+
+// Whether size lanes of a Batch produce exactly the states of Sim::Matches
+// given the same seeds and inputs. Compiler flags that change the rounding of
+// either, such as fused multiply-adds, break this.
+static bool batchMatchesMatch(size_t size, int ticks) {
+  const float aspect = 16.0f / 9.0f;
+  Sim::Batch batch{size, aspect};
+  std::vector<Sim::Match> matches;
+  for (size_t i = 0; i < size; i++) {
+    matches.emplace_back(aspect, Sim::Batch::seedFor(1, i));
+  }
+  for (int tick = 0; tick < ticks; tick++) {
+    auto inputs = scriptedInputs(size, tick + 1);
+    batch.step(inputs);
+    for (size_t i = 0; i < size; i++) {
+      matches[i].step(Sim::unpackInput(inputs[i]));
+      if (!(batch.getState(i) == matches[i].getState())) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static void BM_BatchStep(benchmark::State &state) {
+  auto size = static_cast<size_t>(state.range(0));
+  if (!batchMatchesMatch(std::min<size_t>(size, 64), 4096)) {
+    state.SkipWithError("Sim::Batch diverged from Sim::Match");
+    return;
+  }
+  Sim::Batch batch{size, 16.0f / 9.0f};
+  auto inputs = scriptedInputs(size, 7);
+  for (auto _ : state) {
+    batch.step(inputs);
+    benchmark::DoNotOptimize(batch.getColumns().ballX.data());
+  }
+  state.SetItemsProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_BatchStep)->RangeMultiplier(8)->Range(8, 32768);
+
+// BM_BatchStep plus rewards, auto-reset and writing the observations out.
+static void BM_EnvStep(benchmark::State &state) {
+  auto size = static_cast<size_t>(state.range(0));
+  Sim::Env env{Sim::Side::left, 16.0f / 9.0f};
+  std::vector<float> observations(size * Sim::Env::observationSize);
+  std::vector<float> rewards(size);
+  std::vector<uint8_t> dones(size);
+  auto actions = scriptedInputs(size, 7);
+  env.reset(size, observations);
+  for (auto _ : state) {
+    env.step(actions, observations, rewards, dones);
+    benchmark::DoNotOptimize(observations.data());
+  }
+  state.SetItemsProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_EnvStep)->RangeMultiplier(8)->Range(8, 32768);
+
+// A recorded match as a fixed workload: PONG_BENCH_REPLAY=<file> made with
+// PONG_RECORD.
+static void BM_ReplayFile(benchmark::State &state) {
+  auto path = std::getenv("PONG_BENCH_REPLAY");
+  Sim::Recording recording;
+  if (!path || !Sim::RecordingFile::load(path, recording)) {
+    state.SkipWithError("PONG_BENCH_REPLAY is not a recording");
+    return;
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Sim::replay(recording));
+  }
+  state.SetItemsProcessed(state.iterations() * recording.inputs.size());
+}
+BENCHMARK(BM_ReplayFile)->Unit(benchmark::kMillisecond);
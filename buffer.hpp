@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <bits/utility.h>
+#include <cstdint>
+#include <cstring>
 #include <initializer_list>
 #include <iostream>
 #include <span>
@@ -13,8 +16,39 @@
 #include <GLFW/glfw3.h>
 
 #include "handle.hpp"
+#include "state.hpp"
 #include "traits.hpp"
 
+// Bytes written to buffer objects and textures, per frame and in total.
+class UploadStats {
+public:
+  static inline void record(size_t bytes) {
+    frameBytes += bytes;
+    frameUploads++;
+  }
+
+  static inline void endFrame() {
+    lastFrameBytes = frameBytes;
+    lastFrameUploads = frameUploads;
+    totalBytes += frameBytes;
+    frames++;
+    frameBytes = 0;
+    frameUploads = 0;
+  }
+
+  static inline size_t getLastFrameBytes() { return lastFrameBytes; }
+  static inline size_t getLastFrameUploads() { return lastFrameUploads; }
+  static inline size_t getTotalBytes() { return totalBytes; }
+  static inline size_t getFrames() { return frames; }
+
+private:
+  static inline size_t frameBytes = 0, frameUploads = 0;
+  static inline size_t lastFrameBytes = 0, lastFrameUploads = 0;
+  static inline size_t totalBytes = 0, frames = 0;
+};
+
+// Keeps a CPU copy of what was last written so assigning unchanged contents
+// costs a compare instead of an upload; getVersion() counts real uploads.
 template <typename T> class ArrayBuffer : public glObject {
 public:
   ArrayBuffer(size_t size, int usage = GL_DYNAMIC_STORAGE_BIT)
@@ -23,14 +57,17 @@ public:
   };
 
   ArrayBuffer(std::span<T> buffer, const int usage = GL_DYNAMIC_STORAGE_BIT)
-      : size{buffer.size()}, usage{usage}, handle{} {
+      : size{buffer.size()}, usage{usage}, handle{},
+        shadow(buffer.begin(), buffer.end()) {
     isEmpty = true;
     glNamedBufferStorage(handle, sizeof(T) * buffer.size(), buffer.data(),
                          usage);
+    UploadStats::record(sizeof(T) * buffer.size());
   }
 
   ArrayBuffer(ArrayBuffer &&srcBuffer)
-      : size{srcBuffer.size}, usage{srcBuffer.usage}, handle{} {
+      : size{srcBuffer.size}, usage{srcBuffer.usage}, handle{},
+        shadow{std::move(srcBuffer.shadow)}, version{srcBuffer.version} {
     this->handle = std::move(srcBuffer.handle);
   };
 
@@ -40,24 +77,32 @@ public:
     isEmpty = false;
     glCopyBufferSubData(srcBuffer.handle, handle, 0, 0, size * sizeof(T));
     this->size = srcBuffer.size;
+    shadow = srcBuffer.shadow;
+    version++;
     return *this;
   };
 
   ArrayBuffer &operator=(std::span<T> buffer) {
-    if (buffer.size() == size) {
+    if (buffer.size() == size && !matches(buffer)) {
+      shadow.assign(buffer.begin(), buffer.end());
       subData(buffer.data());
     }
     return *this;
   }
 
+  // Raw upload, bypasses the CPU copy.
   void namedBufferSubData(GLintptr offset, GLsizeiptr size,
                           const GLvoid *data) {
     isEmpty = false;
+    shadow.clear();
+    version++;
+    UploadStats::record(size);
     glNamedBufferSubData(handle, offset, size, data);
   }
 
   virtual const GLuint getHandle() override { return handle; };
   bool empty() { return isEmpty; }
+  uint64_t getVersion() const { return version; }
 
 private:
   const size_t size;
@@ -65,11 +110,103 @@ private:
   int usage;
   bool isEmpty = true;
 
+  bool matches(std::span<T> buffer) const {
+    return shadow.size() == buffer.size() &&
+           std::memcmp(shadow.data(), buffer.data(),
+                       sizeof(T) * buffer.size()) == 0;
+  }
+
   void subData(const T *p) {
     isEmpty = false;
+    version++;
+    UploadStats::record(sizeof(T) * size);
     glNamedBufferSubData(handle, 0, sizeof(T) * size, p);
   }
 
+  BufferHandle handle;
+  std::vector<T> shadow;
+  uint64_t version = 0;
+};
+
+// Buffer for data rewritten every frame. The storage holds `regions` copies
+// of the data and stays mapped (persistent, coherent) for its whole life.
+// Each frame writes the next region with a plain memcpy; a fence placed after
+// the draws that read a region keeps it from being overwritten until the GPU
+// is done with it, so the driver never has to copy or synchronize.
+template <typename T, size_t regions = 3> class StreamBuffer : public glObject {
+public:
+  static constexpr GLbitfield flags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+  StreamBuffer(size_t size) : size{size}, handle{} {
+    glNamedBufferStorage(handle, sizeof(T) * size * regions, NULL, flags);
+    mapped = static_cast<T *>(
+        glMapNamedBufferRange(handle, 0, sizeof(T) * size * regions, flags));
+  }
+
+  StreamBuffer(const StreamBuffer &) = delete;
+  StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+  ~StreamBuffer() {
+    for (auto &e : fences) {
+      if (e) {
+        glDeleteSync(e);
+      }
+    }
+    glUnmapNamedBuffer(handle);
+  }
+
+  // Moves to the next region and copies data into it, waiting first if the
+  // GPU may still be reading that region.
+  void write(std::span<const T> data) {
+    auto bytes = sizeof(T) * std::min(data.size(), size);
+    std::memcpy(next(), data.data(), bytes);
+    UploadStats::record(bytes);
+  }
+
+  // Moves to the next region like write() and returns it, to be filled in
+  // place.
+  T *next() {
+    current = (current + 1) % regions;
+    waitFence(fences[current]);
+    return mapped + current * size;
+  }
+
+  // Call once the draws reading the current region have been issued.
+  void fence() {
+    if (fences[current]) {
+      glDeleteSync(fences[current]);
+    }
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+
+  // Index of the current region's first element, for glDrawArrays' first or
+  // a base instance.
+  GLint getFirst() const { return static_cast<GLint>(current * size); }
+
+  size_t getSize() const { return size; }
+
+  virtual const GLuint getHandle() override { return handle; };
+
+private:
+  static void waitFence(GLsync fence) {
+    if (!fence) {
+      return;
+    }
+    while (true) {
+      auto res = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+      if (res == GL_ALREADY_SIGNALED || res == GL_CONDITION_SATISFIED ||
+          res == GL_WAIT_FAILED) {
+        return;
+      }
+    }
+  }
+
+  const size_t size;
+  size_t current = 0;
+  T *mapped = nullptr;
+  GLsync fences[regions]{};
+
   BufferHandle handle;
 };
 
@@ -110,8 +247,8 @@ public:
 
   virtual const GLuint getHandle() override { return handle; }
 
-  virtual void bind() override { glBindVertexArray(handle); }
-  virtual void unbind() override { glBindVertexArray(0); }
+  virtual void bind() override { GLState::bindVertexArray(handle); }
+  virtual void unbind() override { GLState::bindVertexArray(0); }
 
 private:
   VertexArrayHandle handle{};
@@ -0,0 +1,26 @@
+# Writes every file below SHADER_DIR into OUTPUT as constexpr string views,
+# keyed by their path relative to SHADER_DIR.
+#
+#   cmake -DSHADER_DIR=<dir> -DOUTPUT=<header> -P embed_shaders.cmake
+
+file(GLOB_RECURSE shader_files RELATIVE ${SHADER_DIR} ${SHADER_DIR}/*)
+list(SORT shader_files)
+
+set(content "// Generated by cmake/embed_shaders.cmake from shaders/. Do not edit.\n")
+string(APPEND content "#pragma once\n\n")
+string(APPEND content "#include <string_view>\n#include <utility>\n\n")
+string(APPEND content "namespace EmbeddedShaders {\n\n")
+string(APPEND content "inline constexpr std::pair<std::string_view, std::string_view> files[]{\n")
+foreach(shader_file ${shader_files})
+  file(READ ${SHADER_DIR}/${shader_file} source)
+  string(APPEND content "    {\"${shader_file}\",\n     R\"pong_shader(${source})pong_shader\"},\n")
+endforeach()
+string(APPEND content "};\n\n} // namespace EmbeddedShaders\n")
+
+# only touch the header when it changes, so dependents don't rebuild
+if(EXISTS ${OUTPUT})
+  file(READ ${OUTPUT} previous)
+endif()
+if(NOT "${previous}" STREQUAL "${content}")
+  file(WRITE ${OUTPUT} "${content}")
+endif()
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "batch.hpp"
+#include "simulation.hpp"
+
+// Sim::Batch as a vectorized training environment. Every call writes into
+// buffers the caller owns, one row per match, so stepping allocates nothing
+// and the buffers can be handed to a trainer as they are.
+//
+// Actions are InputBits masks for both paddles, which leaves self-play or a
+// scripted opponent to the caller. Rewards are +1 when `side` scores and -1
+// when the other side does. A match that ends is reset right away: its done
+// flag is set, and its observation row is already the new match's first one.
+// The environment holds no matches until reset().
+
+namespace Sim {
+
+class Env {
+public:
+  // ball x, y, speed x, speed y, left paddle y, right paddle y, game state,
+  // left score, right score
+  static constexpr size_t observationSize = 9;
+
+  Env(Side side, float aspect, uint32_t seed = 1, Config config = {})
+      : side{side}, aspect{aspect}, seed{seed}, config{config},
+        batch{0, aspect, seed, config} {}
+
+  // Starts count new matches. observations holds count * observationSize
+  // floats.
+  void reset(size_t count, std::span<float> observations) {
+    batch = Batch{count, aspect, seed, config};
+    lScores.assign(count, 0);
+    rScores.assign(count, 0);
+    observe(observations);
+  }
+
+  // actions, rewards and dones hold one entry per match.
+  void step(std::span<const uint8_t> actions, std::span<float> observations,
+            std::span<float> rewards, std::span<uint8_t> dones) {
+    batch.step(actions);
+
+    auto &columns = batch.getColumns();
+    const float sign = side == Side::left ? 1.0f : -1.0f;
+    bool anyDone = false;
+    for (size_t i = 0; i < batch.size(); i++) {
+      auto lGain = columns.lScore[i] - lScores[i];
+      auto rGain = columns.rScore[i] - rScores[i];
+      lScores[i] = columns.lScore[i];
+      rScores[i] = columns.rScore[i];
+      rewards[i] = sign * static_cast<float>(lGain - rGain);
+      dones[i] = columns.gameState[i] == static_cast<int32_t>(GameState::over);
+      anyDone |= dones[i] != 0;
+    }
+
+    if (anyDone) {
+      for (size_t i = 0; i < batch.size(); i++) {
+        if (dones[i]) {
+          // the lane's generator carries on as the next match's seed
+          batch.reset(i, columns.rng[i]);
+          lScores[i] = 0;
+          rScores[i] = 0;
+        }
+      }
+    }
+    observe(observations);
+  }
+
+  size_t size() const { return batch.size(); }
+  const Batch &getBatch() const { return batch; }
+
+private:
+  void observe(std::span<float> observations) const {
+    auto &c = batch.getColumns();
+    for (size_t i = 0; i < batch.size(); i++) {
+      auto *row = &observations[i * observationSize];
+      row[0] = c.ballX[i];
+      row[1] = c.ballY[i];
+      row[2] = c.ballSpeedX[i];
+      row[3] = c.ballSpeedY[i];
+      row[4] = c.lPaddleY[i];
+      row[5] = c.rPaddleY[i];
+      row[6] = static_cast<float>(c.gameState[i]);
+      row[7] = static_cast<float>(c.lScore[i]);
+      row[8] = static_cast<float>(c.rScore[i]);
+    }
+  }
+
+  Side side;
+  float aspect;
+  uint32_t seed;
+  Config config;
+  Batch batch;
+  std::vector<int32_t> lScores, rScores; // as of the last step
+};
+
+} // namespace Sim
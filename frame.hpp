@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "buffer.hpp"
+#include "window.hpp"
+
+// Render state shared by every program, written once per frame into a
+// uniform buffer at a fixed binding point. The shaders declare it as
+//
+//   layout(std140, binding = 0) uniform FrameGlobals {
+//     mat4 projection;
+//     vec2 viewport;
+//     float aspect;
+//     float time;
+//   };
+class FrameGlobals {
+public:
+  static constexpr GLuint binding = 0;
+
+  struct Block { // std140
+    glm::mat4 projection;
+    glm::vec2 viewport;
+    float aspect;
+    float time;
+  };
+
+  static inline void update(float time) {
+    auto [width, height] = Window::getSize();
+    auto aspect = Window::getAspect();
+
+    block.projection = glm::ortho(-aspect, aspect, -1.0f, 1.0f, -1.0f, 1.0f);
+    block.viewport = glm::vec2{width, height};
+    block.aspect = aspect;
+    block.time = time;
+
+    if (!buffer) {
+      buffer = std::make_unique<ArrayBuffer<Block>>(1);
+    }
+    *buffer = std::span<Block>{&block, 1};
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer->getHandle());
+  }
+
+  static inline const Block &get() { return block; }
+
+private:
+  static inline Block block{};
+  static inline std::unique_ptr<ArrayBuffer<Block>> buffer{nullptr};
+};
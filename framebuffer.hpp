@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "handle.hpp"
+#include "traits.hpp"
+
+// Offscreen render target with an RGBA8 color and a depth/stencil
+// renderbuffer.
+class Framebuffer : public glObject, public Bindable {
+public:
+  Framebuffer(int width, int height) : width{width}, height{height} {
+    glNamedRenderbufferStorage(color, GL_RGBA8, width, height);
+    glNamedRenderbufferStorage(depth, GL_DEPTH24_STENCIL8, width, height);
+    glNamedFramebufferRenderbuffer(handle, GL_COLOR_ATTACHMENT0,
+                                   GL_RENDERBUFFER, color);
+    glNamedFramebufferRenderbuffer(handle, GL_DEPTH_STENCIL_ATTACHMENT,
+                                   GL_RENDERBUFFER, depth);
+  }
+
+  bool complete() {
+    return glCheckNamedFramebufferStatus(handle, GL_FRAMEBUFFER) ==
+           GL_FRAMEBUFFER_COMPLETE;
+  }
+
+  virtual const GLuint getHandle() override { return handle; }
+
+  virtual void bind() override {
+    glBindFramebuffer(GL_FRAMEBUFFER, handle);
+    glViewport(0, 0, width, height);
+  }
+  virtual void unbind() override { glBindFramebuffer(GL_FRAMEBUFFER, 0); }
+
+  // RGBA pixels, top row first.
+  std::vector<unsigned char> readPixels() {
+    std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4);
+    glNamedFramebufferReadBuffer(handle, GL_COLOR_ATTACHMENT0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, handle);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+                 pixels.data());
+
+    auto pitch = static_cast<size_t>(width) * 4;
+    for (int y = 0; y < height / 2; y++) {
+      std::swap_ranges(pixels.begin() + y * pitch,
+                       pixels.begin() + (y + 1) * pitch,
+                       pixels.begin() + (height - 1 - y) * pitch);
+    }
+    return pixels;
+  }
+
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+
+private:
+  int width, height;
+  FramebufferHandle handle{};
+  RenderbufferHandle color{}, depth{};
+};
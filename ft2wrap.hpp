@@ -3,9 +3,24 @@
 #include "freetype/fttypes.h"
 #include <cstdint>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <string_view>
+#include <tuple>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN // keeps winsock 1 out, see net.hpp
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <freetype2/ft2build.h>
 #include FT_FREETYPE_H
@@ -44,14 +59,123 @@ inline long getPoint(long integerPart, unsigned long decimalPart) {
   return (integerPart << 6) + decimalPart;
 }
 
+// A font file mapped into memory. Faces opened from the same path share the
+// mapping, whichever thread they are on.
+class FontFile {
+public:
+  static std::shared_ptr<const FontFile> open(const std::string &path) {
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<const FontFile>> files;
+
+    std::lock_guard lock{mutex};
+    if (auto file = files[path].lock()) {
+      return file;
+    }
+    std::shared_ptr<const FontFile> file{new FontFile{path}};
+    files[path] = file;
+    return file;
+  }
+
+  FontFile(const FontFile &) = delete;
+  FontFile &operator=(const FontFile &) = delete;
+
+  ~FontFile() {
+#ifdef _WIN32
+    if (bytes) {
+      UnmapViewOfFile(bytes);
+    }
+#else
+    if (bytes) {
+      munmap(const_cast<FT_Byte *>(bytes), length);
+    }
+#endif
+  }
+
+  const FT_Byte *data() const { return bytes; }
+  FT_Long size() const { return static_cast<FT_Long>(length); }
+
+private:
+  FontFile(const std::string &path) {
+#ifdef _WIN32
+    auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file != INVALID_HANDLE_VALUE) {
+      LARGE_INTEGER fileSize;
+      auto mapping = GetFileSizeEx(file, &fileSize)
+                         ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0,
+                                              NULL)
+                         : NULL;
+      if (mapping) {
+        bytes = static_cast<const FT_Byte *>(
+            MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        length = bytes ? static_cast<size_t>(fileSize.QuadPart) : 0;
+        CloseHandle(mapping);
+      }
+      CloseHandle(file);
+    }
+#else
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd >= 0 && fstat(fd, &info) == 0 && info.st_size > 0) {
+      auto mapped =
+          mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped != MAP_FAILED) {
+        bytes = static_cast<const FT_Byte *>(mapped);
+        length = static_cast<size_t>(info.st_size);
+      }
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+#endif
+    if (!bytes) {
+      std::cerr << "can't map font " << path << std::endl;
+    }
+  }
+
+  const FT_Byte *bytes = nullptr;
+  size_t length = 0;
+};
+
+// FreeType library of one thread. A library and its faces must only be used
+// from one thread at a time, so worker threads each get their own.
+class Library {
+public:
+  Library() { FT_Init_FreeType(&library); }
+  ~Library() { FT_Done_FreeType(library); }
+
+  Library(const Library &) = delete;
+  Library &operator=(const Library &) = delete;
+
+  operator FT_Library() const { return library; }
+
+private:
+  FT_Library library;
+};
+
 class Face : public Ft2Obj {
 public:
-  Face(std::string_view fontPath) {
-    err = FT_New_Face(ftlib, fontPath.data(), 0, &face);
+  Face(std::string_view fontPath) : Face{fontPath, freetype2::ftlib} {}
+
+  // Face of the given library, reading the shared mapping of the font.
+  Face(std::string_view fontPath, FT_Library library)
+      : file{FontFile::open(std::string{fontPath})} {
+    if (!file->data()) {
+      err = FT_Err_Cannot_Open_Resource;
+      return;
+    }
+    err = FT_New_Memory_Face(library, file->data(), file->size(), 0, &face);
     FT_Select_Charmap(face, FT_ENCODING_UNICODE);
   }
 
-  ~Face() { FT_Done_Face(face); }
+  ~Face() {
+    if (face) {
+      FT_Done_Face(face);
+    }
+  }
+
+  Face(const Face &) = delete;
+  Face &operator=(const Face &) = delete;
 
   auto setCharSize(FT_F26Dot6 charWidthPt, FT_F26Dot6 charHeightPt,
                    FT_UInt horizonalRes, FT_UInt verticalRes) {
@@ -75,11 +199,35 @@ public:
     return FT_Render_Glyph(face->glyph, mode);
   }
 
+  bool hasKerning() const { return FT_HAS_KERNING(face); }
+
+  auto getKerning(FT_UInt leftGlyph, FT_UInt rightGlyph, FT_UInt kernMode) {
+    FT_Vector kerning{};
+    FT_Get_Kerning(face, leftGlyph, rightGlyph, kernMode, &kerning);
+    return kerning;
+  }
+
   const FT_Face &operator->() const { return face; }
 
 private:
-  FT_Face face;
-  FT_Library &ftlib = freetype2::ftlib;
+  FT_Face face = nullptr;
+  std::shared_ptr<const FontFile> file; // outlives face
 };
 
+// Face of the font for the calling thread only, with the thread's own
+// library.
+inline Face &threadFace(const std::string &fontPath) {
+  thread_local Library library;
+  thread_local std::map<std::string, Face> faces; // destroyed before library
+  auto found = faces.find(fontPath);
+  if (found == faces.end()) {
+    found = faces
+                .emplace(std::piecewise_construct,
+                         std::forward_as_tuple(fontPath),
+                         std::forward_as_tuple(fontPath, library))
+                .first;
+  }
+  return found->second;
+}
+
 } // namespace Ft2Wrap
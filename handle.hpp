@@ -7,6 +7,8 @@
 #include <ostream>
 #include <utility>
 
+#include "state.hpp"
+
 template <typename ALLOCATOR> class Handle {
 public:
   template <typename... T> Handle(T &&...args) {
@@ -52,7 +54,10 @@ std::ostream &operator<<(std::ostream &stream,
 struct ProgramAllocator {
 public:
   GLuint alloc() { return glCreateProgram(); }
-  void free(GLuint handle) { glDeleteProgram(handle); }
+  void free(GLuint handle) {
+    GLState::forgetProgram(handle);
+    glDeleteProgram(handle);
+  }
 };
 
 struct ShaderAllocator {
@@ -79,7 +84,10 @@ public:
     return h;
   }
 
-  void free(GLuint handle) { glDeleteVertexArrays(1, &handle); }
+  void free(GLuint handle) {
+    GLState::forgetVertexArray(handle);
+    glDeleteVertexArrays(1, &handle);
+  }
 };
 
 struct TextureAllocator {
@@ -88,7 +96,37 @@ struct TextureAllocator {
     glCreateTextures(target, 1, &h);
     return h;
   }
-  void free(GLuint handle) { glDeleteTextures(1, &handle); }
+  void free(GLuint handle) {
+    GLState::forgetTexture(handle);
+    glDeleteTextures(1, &handle);
+  }
+};
+
+struct FramebufferAllocator {
+  GLuint alloc() {
+    GLuint h;
+    glCreateFramebuffers(1, &h);
+    return h;
+  }
+  void free(GLuint handle) { glDeleteFramebuffers(1, &handle); }
+};
+
+struct RenderbufferAllocator {
+  GLuint alloc() {
+    GLuint h;
+    glCreateRenderbuffers(1, &h);
+    return h;
+  }
+  void free(GLuint handle) { glDeleteRenderbuffers(1, &handle); }
+};
+
+struct QueryAllocator {
+  GLuint alloc(GLenum target) {
+    GLuint h;
+    glCreateQueries(target, 1, &h);
+    return h;
+  }
+  void free(GLuint handle) { glDeleteQueries(1, &handle); }
 };
 
 using ShaderHandle = Handle<ShaderAllocator>;
@@ -96,3 +134,6 @@ using ShaderProgramHandle = Handle<ProgramAllocator>;
 using BufferHandle = Handle<BufferAllocator>;
 using VertexArrayHandle = Handle<VertexArrayAllocator>;
 using TextureHandle = Handle<TextureAllocator>;
+using QueryHandle = Handle<QueryAllocator>;
+using FramebufferHandle = Handle<FramebufferAllocator>;
+using RenderbufferHandle = Handle<RenderbufferAllocator>;
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "framebuffer.hpp"
+
+namespace Headless {
+
+// GL 4.6 core context without any window or display, on EGL's surfaceless
+// platform (Mesa's llvmpipe when there is no GPU). Nothing has a default
+// framebuffer; render into a Framebuffer.
+class Context {
+public:
+  Context() {}
+
+  Context(const Context &) = delete;
+  Context &operator=(const Context &) = delete;
+
+  ~Context() {
+    if (display == EGL_NO_DISPLAY) {
+      return;
+    }
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT) {
+      eglDestroyContext(display, context);
+    }
+    eglTerminate(display);
+  }
+
+  bool create() {
+    auto getPlatformDisplay =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay) {
+      display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                   EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (display == EGL_NO_DISPLAY) {
+      display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+      std::cerr << "Can't initialize EGL" << std::endl;
+      return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+      std::cerr << "EGL has no desktop OpenGL" << std::endl;
+      return false;
+    }
+
+    EGLint configAttribs[]{EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config = NULL; // EGL_NO_CONFIG_KHR
+    EGLint configCount = 0;
+    eglChooseConfig(display, configAttribs, &config, 1, &configCount);
+    if (configCount == 0) {
+      config = NULL;
+    }
+
+    EGLint contextAttribs[]{EGL_CONTEXT_MAJOR_VERSION,
+                            4,
+                            EGL_CONTEXT_MINOR_VERSION,
+                            6,
+                            EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                            EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                            EGL_NONE};
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT) {
+      std::cerr << "Can't create a GL 4.6 core context" << std::endl;
+      return false;
+    }
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+      std::cerr << "Can't make the headless context current" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+private:
+  EGLDisplay display = EGL_NO_DISPLAY;
+  EGLContext context = EGL_NO_CONTEXT;
+};
+
+// Writes the framebuffer's pixels to path. A .rgba path gets the raw RGBA
+// bytes (top row first); anything else goes through OpenCV, e.g. .png.
+inline bool writeFrame(Framebuffer &framebuffer,
+                       const std::filesystem::path &path) {
+  auto pixels = framebuffer.readPixels();
+
+  if (path.extension() == ".rgba") {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(pixels.data()), pixels.size());
+    if (!file) {
+      std::cerr << "can't write frame to " << path << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  for (size_t i = 0; i < pixels.size(); i += 4) {
+    std::swap(pixels[i], pixels[i + 2]); // OpenCV wants BGRA
+  }
+  cv::Mat bgra{framebuffer.getHeight(), framebuffer.getWidth(), CV_8UC4,
+               pixels.data()};
+  if (!cv::imwrite(path.string(), bgra)) {
+    std::cerr << "can't write frame to " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace Headless
@@ -2,11 +2,15 @@
 #pragma once
 
 #include <cmath>
-#include <corecrt.h>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <iterator>
+#include <memory>
+#include <span>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -16,47 +20,156 @@
 #include <opencv2/opencv.hpp>
 
 #include "buffer.hpp"
+#include "loader.hpp"
+#include "render.hpp"
 #include "shader.hpp"
 #include "texture.hpp"
 #include "traits.hpp"
-#include "window.hpp"
 
-class Image : public Drawable {
-public:
-  Image(std::string_view filename)
-      : array{}, textureVerticesBuf{textureVertices}, uvBuf{uv},
-        texture{GL_TEXTURE_2D} {
+// Images are decoded on the Loader's workers; what's left for the GL thread
+// is copying the pixels into a mapped staging buffer and starting the
+// texture upload from it.
 
-    auto img = cv::imread(filename.data());
-    if (img.empty()) {
-      std::cout << "image is empty" << std::endl;
+namespace Assets {
+
+// Tightly packed RGBA8 rows, top row first.
+struct Pixels {
+  int width = 0, height = 0;
+  std::vector<uint8_t> rgba;
+};
+
+inline Pixels decodeImage(const std::string &path) {
+  auto image = cv::imread(path, cv::IMREAD_COLOR);
+  if (image.empty()) {
+    std::cerr << "can't decode image " << path << std::endl;
+    return {};
+  }
+  cv::Mat rgba;
+  cv::cvtColor(image, rgba, cv::COLOR_BGR2RGBA);
+
+  Pixels pixels{rgba.cols, rgba.rows};
+  pixels.rgba.resize(static_cast<size_t>(rgba.cols) * rgba.rows * 4);
+  for (int y = 0; y < rgba.rows; y++) {
+    std::memcpy(pixels.rgba.data() + static_cast<size_t>(y) * rgba.cols * 4,
+                rgba.ptr(y), static_cast<size_t>(rgba.cols) * 4);
+  }
+  return pixels;
+}
+
+// Pixel unpack buffer the uploads of a frame are copied into, so
+// glTextureSubImage2D returns without waiting for the driver to copy client
+// memory. Regions are fenced like any StreamBuffer.
+class Staging {
+public:
+  static constexpr size_t regionSize = 8 << 20;
+  static constexpr size_t alignment = 256;
+
+  // Copies pixels into the frame's region and uploads them to texture from
+  // there. Pixels that don't fit anymore are uploaded from client memory.
+  void upload(Texture &texture, GLsizei width, GLsizei height, GLenum format,
+              std::span<const uint8_t> pixels) {
+    if (!region) {
+      region = buffer.next();
+      used = 0;
+    }
+    auto offset = (used + alignment - 1) / alignment * alignment;
+    UploadStats::record(pixels.size());
+    if (offset + pixels.size() > regionSize) {
+      texture.textureSubImage2D(0, 0, 0, width, height, format,
+                                GL_UNSIGNED_BYTE, pixels.data());
+      return;
     }
+    std::memcpy(region + offset, pixels.data(), pixels.size());
+    used = offset + pixels.size();
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.getHandle());
+    auto start = static_cast<uintptr_t>(buffer.getFirst()) + offset;
+    texture.textureSubImage2D(0, 0, 0, width, height, format, GL_UNSIGNED_BYTE,
+                              reinterpret_cast<const void *>(start));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
 
-    auto width = img.size().width;
-    auto height = img.size().height;
-    auto data = img.data;
+  // Ends the uploads since the last end(); the next upload starts a region.
+  void end() {
+    if (region && used > 0) {
+      buffer.fence();
+    }
+    region = nullptr;
+  }
 
-    Shader vertexShader{vertexShaderPath, GL_VERTEX_SHADER};
-    Shader fragmentShader{fragmentShaderPath, GL_FRAGMENT_SHADER};
+private:
+  StreamBuffer<uint8_t> buffer{regionSize};
+  uint8_t *region = nullptr;
+  size_t used = 0;
+};
 
-    vertexShader.compile();
-    fragmentShader.compile();
+// Staging of the image uploads, ended after every Loader::update().
+inline Staging &getStaging() {
+  static std::unique_ptr<Staging> staging;
+  if (!staging) {
+    staging = std::make_unique<Staging>();
+    Loader::afterUpdate([] { staging->end(); });
+  }
+  return *staging;
+}
+
+// 1x1 grey texture drawn in place of textures still loading.
+inline Texture &placeholder() {
+  static std::unique_ptr<Texture> texture;
+  if (!texture) {
+    texture = std::make_unique<Texture>(GL_TEXTURE_2D);
+    texture->textureStorage2D(1, GL_RGBA8, 1, 1);
+    uint8_t grey[4]{128, 128, 128, 255};
+    texture->textureSubImage2D(0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+  }
+  return *texture;
+}
 
-    shader = ShaderProgram{vertexShader, fragmentShader};
+// Texture decoded from an image file by the Loader. Until it has arrived,
+// get() is the placeholder.
+class ImageTexture {
+public:
+  ImageTexture(std::string path) {
+    Loader::load([path] { return decodeImage(path); },
+                 [weak = std::weak_ptr{loaded}](Pixels pixels) {
+                   auto target = weak.lock();
+                   if (target && pixels.width > 0) {
+                     *target = upload(pixels);
+                   }
+                 });
+  }
 
-    texture.textureStorage2D(1, GL_RGBA8, width, height);
-    texture.textureSubImage2D(0, 0, 0, width, height, GL_BGR_EXT,
-                              GL_UNSIGNED_BYTE, data);
+  bool ready() const { return *loaded != nullptr; }
+  Texture &get() { return ready() ? **loaded : placeholder(); }
 
-    texture.pixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    texture.getnerateTextureMipmap();
+private:
+  static std::unique_ptr<Texture> upload(const Pixels &pixels) {
+    auto texture = std::make_unique<Texture>(GL_TEXTURE_2D);
+    texture->textureStorage2D(1, GL_RGBA8, pixels.width, pixels.height);
+    getStaging().upload(*texture, pixels.width, pixels.height, GL_RGBA,
+                                pixels.rgba);
+
+    texture->textureParameteri(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    texture->textureParameteri(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    texture->textureParameteri(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    texture->textureParameteri(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    return texture;
+  }
 
-    texture.textureParameteri(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    texture.textureParameteri(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  // shared with the pending load, which drops its result if this is gone
+  std::shared_ptr<std::unique_ptr<Texture>> loaded =
+      std::make_shared<std::unique_ptr<Texture>>();
+};
 
-    texture.textureParameteri(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    texture.textureParameteri(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+} // namespace Assets
 
+// The file is decoded in the background; a placeholder is drawn until the
+// texture has been uploaded.
+class Image : public Drawable {
+public:
+  Image(std::string_view filename)
+      : array{}, textureVerticesBuf{textureVertices}, uvBuf{uv},
+        texture{std::string{filename}} {
     array.vertexArrayVertexBuffer(0, textureVerticesBuf, 0, sizeof(float) * 3);
     array.vertexArrayVertexBuffer(1, uvBuf, 0, sizeof(float) * 2);
 
@@ -68,20 +181,21 @@ public:
 
     array.vertexArrayAttribBinding(0, 0);
     array.vertexArrayAttribBinding(1, 1);
-
-    shader.use();
-    glUniform1f(2, Window::getAspect());
-    glUniform1i(3, 0);
   }
 
   virtual void draw() override {
-    shader.use();
-    texture.bind();
-    array.bind();
-    glUniform1f(2, Window::getAspect());
-    glDrawArrays(GL_TRIANGLE_FAN, 0, std::size(textureVertices));
-    texture.unbind();
-    array.unbind();
+    auto &current = texture.get();
+    RenderQueue::submit(
+        {RenderQueue::world, *shader, current.getHandle(), array.getHandle()},
+        "Image", this,
+        [](void *object, const RenderQueue::Args &args) {
+          auto &self = *static_cast<Image *>(object);
+          self.shader->use();
+          static_cast<Texture *>(args.resource)->bind();
+          self.array.bind();
+          glDrawArrays(GL_TRIANGLE_FAN, 0, std::size(self.textureVertices));
+        },
+        {0, 0, &current});
   }
 
 private:
@@ -102,9 +216,11 @@ private:
   VertexArray array;
   ArrayBuffer<glm::vec3> textureVerticesBuf;
   ArrayBuffer<glm::vec2> uvBuf;
-  Texture texture;
+  Assets::ImageTexture texture;
 
-  ShaderProgram shader;
-  static inline std::string vertexShaderPath{"../shaders/image/image.vert"};
-  static inline std::string fragmentShaderPath{"../shaders/image/image.frag"};
+  static inline std::string vertexShaderPath{"image/image.vert"};
+  static inline std::string fragmentShaderPath{"image/image.frag"};
+  std::shared_ptr<ShaderProgram> shader{
+      ShaderProgram::get({{vertexShaderPath, GL_VERTEX_SHADER},
+                          {fragmentShaderPath, GL_FRAGMENT_SHADER}})};
 };
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Loads assets without stalling the frame loop. The work of a load runs on a
+// pool of worker threads; what's left of it for the GL thread runs in
+// Loader::update(), a bounded amount per frame.
+
+namespace Assets {
+
+class Loader {
+public:
+  // Runs work() on a worker thread, then finish(result) on the GL thread
+  // from update().
+  template <typename Work, typename Finish>
+  static void load(Work work, Finish finish) {
+    start();
+    inFlight++;
+    std::lock_guard lock{mutex};
+    jobs.push_back([work = std::move(work), finish = std::move(finish)] {
+      auto result = std::make_shared<decltype(work())>(work());
+      std::lock_guard lock{mutex};
+      finished.push_back([finish, result] { finish(std::move(*result)); });
+    });
+    wake.notify_one();
+  }
+
+  // Finishes loads whose work is done until budget is used up, at least one
+  // per call. Call once per frame on the GL thread.
+  static void update(std::chrono::microseconds budget) {
+    auto end = std::chrono::steady_clock::now() + budget;
+    bool finishedAny = false;
+    while (true) {
+      std::function<void()> next;
+      {
+        std::lock_guard lock{mutex};
+        if (finished.empty()) {
+          break;
+        }
+        next = std::move(finished.front());
+        finished.pop_front();
+      }
+      next();
+      finishedAny = true;
+      inFlight--;
+      if (std::chrono::steady_clock::now() >= end) {
+        break;
+      }
+    }
+    if (finishedAny) {
+      for (auto &hook : afterUpdateHooks) {
+        hook();
+      }
+    }
+  }
+
+  // Runs hook at the end of every update() that finished a load, e.g. to
+  // fence the GL work the finishes started.
+  static void afterUpdate(std::function<void()> hook) {
+    afterUpdateHooks.push_back(std::move(hook));
+  }
+
+  // Finishes every load started so far, waiting for the workers. For
+  // startup screens and reproducible headless runs.
+  static void finish() {
+    while (inFlight > 0) {
+      update(std::chrono::hours{1});
+      std::this_thread::yield();
+    }
+  }
+
+  // Loads started and not finished yet.
+  static size_t pending() { return inFlight; }
+
+private:
+  static void start() {
+    std::call_once(started, [] {
+      // the simulation and the GL thread keep a core each
+      auto cores = std::thread::hardware_concurrency();
+      for (unsigned i = 0; i < (cores > 3 ? cores - 2 : 1); i++) {
+        workers.emplace_back(run);
+      }
+    });
+  }
+
+  static void run(std::stop_token stop) {
+    while (true) {
+      std::function<void()> job;
+      {
+        std::unique_lock lock{mutex};
+        if (!wake.wait(lock, stop, [] { return !jobs.empty(); })) {
+          return;
+        }
+        job = std::move(jobs.front());
+        jobs.pop_front();
+      }
+      job();
+    }
+  }
+
+  static inline std::mutex mutex;
+  static inline std::condition_variable_any wake;
+  static inline std::deque<std::function<void()>> jobs;
+  static inline std::deque<std::function<void()>> finished;
+  static inline std::atomic<size_t> inFlight = 0;
+  static inline std::vector<std::function<void()>> afterUpdateHooks;
+  static inline std::once_flag started;
+  static inline std::vector<std::jthread> workers; // stopped and joined first
+};
+
+} // namespace Assets
@@ -1,12 +1,20 @@
+#include <atomic>
+#include <charconv>
 #include <chrono>
-#include <codecvt>
+#include <cmath>
 #include <cstddef>
+#include <cstdlib>
 #include <cwchar>
+#include <filesystem>
+#include <functional>
 #include <glm/fwd.hpp>
 #include <initializer_list>
+#include <iomanip>
 #include <ios>
 #include <iostream>
 #include <opencv4/opencv2/imgcodecs.hpp>
+#include <optional>
+#include <random>
 #include <span>
 #include <sstream>
 #include <string>
@@ -19,12 +27,242 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include "loader.hpp"
 #include "debug.hpp"
+#include "frame.hpp"
+#include "profiler.hpp"
+#ifdef PONG_HEADLESS
+#include "headless.hpp"
+#endif
 #include "pong.hpp"
+#include "utf8.hpp"
+#ifdef _WIN32
+#include <windows.h> // after pong.hpp, whose sockets need winsock 2
+#endif
 
 #define WIDTH 1080
 #define HEIGHT 720
 
+// GL state shared by the windowed and the headless context.
+void InitGL() {
+  glEnable(GL_ALPHA_TEST);
+
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  // glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  // glEnable(GL_DEBUG_OUTPUT);
+
+  glDebugMessageCallback(openglOnError, NULL);
+
+  Ft2Wrap::freetype2::init();
+
+  ProgramBinaryCache::setDirectory("shader_cache");
+  if (auto shaderDir = std::getenv("PONG_SHADER_DIR")) {
+    Shader::setSourceDirectory(shaderDir); // load shaders/ from disk
+  }
+  GpuProfiler::setEnabled(std::getenv("PONG_PROFILE") != nullptr);
+  auto text = std::getenv("PONG_TEXT");
+  if (text && std::string_view{text} == "sdf") {
+    String::defaultMode = GlyphMode::sdf;
+  }
+}
+
+void PrintStats() {
+  if (GpuProfiler::isEnabled()) {
+    GpuProfiler::dump(std::cout);
+  }
+
+  if (UploadStats::getFrames() > 0) {
+    std::cout << "uploaded " << UploadStats::getTotalBytes() << " bytes in "
+              << UploadStats::getFrames() << " frames ("
+              << UploadStats::getTotalBytes() / UploadStats::getFrames()
+              << " bytes per frame)" << std::endl;
+    std::cout << "state changes: " << GLState::getIssued() << " issued, "
+              << GLState::getSkipped() << " skipped" << std::endl;
+  }
+}
+
+// PONG_REPLAY=<file> plays a recorded match instead of reading the keyboard;
+// its seed and config replace the command line's.
+bool LoadReplay(std::optional<Sim::Recording> &recording, Sim::Config &config,
+                uint32_t &seed) {
+  auto path = std::getenv("PONG_REPLAY");
+  if (!path) {
+    return true;
+  }
+  Sim::Recording loaded;
+  if (!Sim::RecordingFile::load(path, loaded)) {
+    return false;
+  }
+  auto validAspect = [](float aspect) {
+    return std::isfinite(aspect) && aspect > 0;
+  };
+  bool valid = loaded.config.valid() && validAspect(loaded.aspect);
+  for (auto &&[tick, aspect] : loaded.aspectChanges) {
+    valid = valid && validAspect(aspect);
+  }
+  if (!valid) {
+    std::cerr << "recording " << path << " has an invalid config" << std::endl;
+    return false;
+  }
+  config = loaded.config;
+  seed = loaded.seed;
+  recording = std::move(loaded);
+  return true;
+}
+
+// PONG_RECORD=<file> saves every tick played, for replaying it later.
+void SaveRecording(const Pong &pongGame) {
+  if (auto path = std::getenv("PONG_RECORD")) {
+    Sim::RecordingFile::save(pongGame.getRecording(), path);
+  }
+}
+
+// PONG_NET=<left|right>:<local port>:<peer host>:<peer port> plays against
+// another machine. Both sides need the same tick rate, and PONG_NET_SEED if
+// set. PONG_NET_LATENCY=<ms> and PONG_NET_LOSS=<0..1> degrade the outgoing
+// datagrams to try it over loopback.
+bool ConnectNetplay(Pong &pongGame, const Sim::Config &config) {
+  auto spec = std::getenv("PONG_NET");
+  if (!spec) {
+    return true;
+  }
+  std::istringstream stream{spec};
+  std::string side, localPort, host, port;
+  std::getline(stream, side, ':');
+  std::getline(stream, localPort, ':');
+  std::getline(stream, host, ':');
+  std::getline(stream, port);
+  if ((side != "left" && side != "right") || localPort.empty() ||
+      host.empty() || port.empty()) {
+    std::cerr << "PONG_NET should be <left|right>:<port>:<host>:<port>"
+              << std::endl;
+    return false;
+  }
+
+  auto seedEnv = std::getenv("PONG_NET_SEED");
+  uint32_t seed = seedEnv ? std::stoul(seedEnv) : 1;
+  // the aspect places the paddles, so both sides use the initial window's
+  auto session = std::make_unique<NetSession>(
+      side == "left" ? Sim::Side::left : Sim::Side::right,
+      static_cast<float>(WIDTH) / HEIGHT, seed, config);
+
+  auto &link = session->getLink();
+  if (!link.open(std::stoi(localPort), host, std::stoi(port))) {
+    return false;
+  }
+  if (auto latency = std::getenv("PONG_NET_LATENCY")) {
+    link.setLatency(std::chrono::milliseconds(std::stoi(latency)));
+  }
+  if (auto loss = std::getenv("PONG_NET_LOSS")) {
+    link.setLoss(std::stof(loss));
+  }
+  pongGame.connect(std::move(session));
+  return true;
+}
+
+// PONG_SPECTATE_PORT=<port> streams the match to viewers connecting to it;
+// PONG_WATCH=<host>:<port> is such a viewer.
+bool StartSpectating(Pong &pongGame,
+                     std::unique_ptr<Spectate::Server> &server) {
+  if (auto port = std::getenv("PONG_SPECTATE_PORT")) {
+    server = std::make_unique<Spectate::Server>();
+    if (!server->listen(std::stoi(port))) {
+      return false;
+    }
+  }
+  auto address = std::getenv("PONG_WATCH");
+  if (!address) {
+    return true;
+  }
+  std::string_view spec{address};
+  auto colon = spec.rfind(':');
+  if (colon == std::string_view::npos) {
+    std::cerr << "PONG_WATCH should be <host>:<port>" << std::endl;
+    return false;
+  }
+  auto client = std::make_unique<Spectate::Client>();
+  if (!client->connect(std::string{spec.substr(0, colon)},
+                       std::stoi(std::string{spec.substr(colon + 1)}))) {
+    return false;
+  }
+  pongGame.watch(std::move(client));
+  return true;
+}
+
+// Steps the match every `tick` until running is cleared. It has its own
+// thread, so neither drawing nor waiting for vsync delays input sampling or a
+// tick. After a stall it drops time instead of simulating a burst of ticks.
+void RunSimulation(Pong &pongGame, Spectate::Server *spectators,
+                   std::chrono::duration<double> tick,
+                   const std::atomic<bool> &running) {
+  using clock = std::chrono::steady_clock;
+  const auto step = std::chrono::duration_cast<clock::duration>(tick);
+  const std::chrono::duration<double> maxLag{0.25};
+
+  auto next = clock::now();
+  while (running) {
+    pongGame.update();
+    if (spectators) {
+      spectators->broadcast(pongGame.getState());
+    }
+    next += step;
+    if (clock::now() - next > maxLag) {
+      next = clock::now();
+    }
+    std::this_thread::sleep_until(next);
+  }
+}
+
+// Draws the latest tick published by the simulation and presents it until
+// running is cleared. It has the GL context, so a slow swap or a vsync wait
+// only holds up the next frame, never the event loop that samples input.
+void RunRenderer(GLFWwindow *window, Pong &pongGame,
+                 std::chrono::duration<double> tick,
+                 const std::atomic<bool> &running) {
+  glfwMakeContextCurrent(window);
+  while (running) {
+    Window::updateViewport();
+    pongGame.present(tick);
+
+    GpuProfiler::begin("frame");
+
+    GpuProfiler::begin("clear");
+    glClearColor(0.9, 0.9, 0.9, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    GpuProfiler::end();
+
+    GpuProfiler::begin("draw");
+    Assets::Loader::update(std::chrono::milliseconds{2});
+    FrameGlobals::update(static_cast<float>(glfwGetTime()));
+    pongGame.draw();
+    GpuProfiler::end();
+
+    GpuProfiler::begin("swap"); // includes the multisample resolve
+    glfwSwapBuffers(window);
+    GpuProfiler::end();
+
+    GpuProfiler::end();
+    GpuProfiler::endFrame();
+    UploadStats::endFrame();
+  }
+  glfwMakeContextCurrent(nullptr);
+}
+
+Sim::Input ReadKeyboard(GLFWwindow *window) {
+  auto held = [window](int key) {
+    return glfwGetKey(window, key) == GLFW_PRESS;
+  };
+  Sim::Input input;
+  input.rUp = held(GLFW_KEY_O);
+  input.rDown = held(GLFW_KEY_L);
+  input.lUp = held(GLFW_KEY_Q);
+  input.lDown = held(GLFW_KEY_A);
+  input.space = held(GLFW_KEY_SPACE);
+  return input;
+}
+
 GLFWwindow *const Init() {
   atexit(glfwTerminate);
 
@@ -53,30 +291,94 @@ GLFWwindow *const Init() {
     return GL_FALSE;
   }
 
-  glEnable(GL_ALPHA_TEST);
-
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
   glfwSwapInterval(1);
-
-  // glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-  // glEnable(GL_DEBUG_OUTPUT);
-
-  glDebugMessageCallback(openglOnError, NULL);
   glfwSetErrorCallback(glfwOnError);
 
-  Ft2Wrap::freetype2::init();
+  InitGL();
 
   return window;
 }
 
-int main(int argc, char **argv) {
-  GLFWwindow *const window = Init();
+#ifdef PONG_HEADLESS
+// Renders `frames` frames into an offscreen framebuffer, advancing the match
+// one tick per frame so runs are reproducible; with a replay and no frame
+// count it runs to the end of the recording. Each frame is written to
+// PONG_DUMP_DIR as frame_NNNNN.png, or as raw .rgba with
+// PONG_DUMP_FORMAT=rgba.
+int RunHeadless(std::wstring lName, std::wstring rName, Sim::Config config,
+                uint32_t seed, std::optional<Sim::Recording> recording,
+                int frames) {
+  if (frames <= 0 && !recording) {
+    std::cerr << "PONG_HEADLESS needs a frame count" << std::endl;
+    return 1;
+  }
 
-  if (window == GL_FALSE) {
+  Headless::Context context;
+  if (!context.create()) {
     return 1;
-  };
+  }
+  // glewInit() insists on a GLX display; only the entry points are needed
+  if (glewContextInit() != GLEW_OK) {
+    std::cout << "can't initialize glew" << std::endl;
+    return 1;
+  }
+  Window::setSize(WIDTH, HEIGHT);
+  InitGL();
+
+  Framebuffer framebuffer{WIDTH, HEIGHT};
+  if (!framebuffer.complete()) {
+    std::cerr << "offscreen framebuffer is incomplete" << std::endl;
+    return 1;
+  }
+
+  auto dumpDir = std::getenv("PONG_DUMP_DIR");
+  auto dumpFormat = std::getenv("PONG_DUMP_FORMAT");
+  std::string extension = dumpFormat ? dumpFormat : "png";
+  if (dumpDir) {
+    std::filesystem::create_directories(dumpDir);
+  }
+
+  Pong::prewarm();
+  Assets::Loader::finish();
+  Pong pongGame{lName, rName, config, seed};
+  if (recording) {
+    pongGame.replay(std::move(*recording));
+  }
+
+  for (int frame = 0; frames > 0 ? frame < frames : !pongGame.replayFinished();
+       frame++) {
+    pongGame.update();
+    pongGame.update(1.0f);
+
+    framebuffer.bind();
+    glClearColor(0.9, 0.9, 0.9, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    GpuProfiler::begin("draw");
+    Assets::Loader::finish(); // frames shouldn't depend on load timing
+    FrameGlobals::update(frame * pongGame.getTickDuration());
+    pongGame.draw();
+    GpuProfiler::end();
+    GpuProfiler::endFrame();
+    UploadStats::endFrame();
+
+    if (dumpDir) {
+      std::ostringstream name;
+      name << "frame_" << std::setw(5) << std::setfill('0') << frame << '.'
+           << extension;
+      Headless::writeFrame(framebuffer,
+                           std::filesystem::path{dumpDir} / name.str());
+    }
+  }
+  glFinish();
+
+  SaveRecording(pongGame);
+  PrintStats();
+  return 0;
+}
+#endif
+
+int main(int argc, char **argv) {
   if (argc < 3) {
     std::cout << "Please input player name" << std::endl;
     return 1;
@@ -84,23 +386,104 @@ int main(int argc, char **argv) {
   std::string lp{argv[1]};
   std::string rp{argv[2]};
 
-  std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+  Sim::Config config;
+  if (argc > 3) {
+    // simulation ticks per second
+    std::string_view arg{argv[3]};
+    float tickRate = 0;
+    auto [end, error] =
+        std::from_chars(arg.data(), arg.data() + arg.size(), tickRate);
+    if (error != std::errc{} || end != arg.data() + arg.size() ||
+        !Sim::Config::validTickRate(tickRate)) {
+      std::cerr << "usage: " << argv[0] << " left right [ticks per second]"
+                << std::endl
+                << "tick rate must be a positive number, got " << arg
+                << std::endl;
+      return 1;
+    }
+    config.tickRate = tickRate;
+  }
+  uint32_t seed = std::random_device{}();
 
-  Pong pongGame{converter.from_bytes(lp.data()),
-                converter.from_bytes(rp.data())};
+  std::optional<Sim::Recording> recording;
+  if (!LoadReplay(recording, config, seed)) {
+    return 1;
+  }
 
-  glfwSetWindowSizeCallback(window, Window::onResize);
+  if (auto frames = std::getenv("PONG_HEADLESS")) {
+#ifdef PONG_HEADLESS
+    return RunHeadless(Utf8::decode(lp), Utf8::decode(rp), config, seed,
+                       std::move(recording), std::stoi(frames));
+#else
+    std::cerr << "built without headless support" << std::endl;
+    return 1;
+#endif
+  }
 
-  while (glfwWindowShouldClose(window) == GL_FALSE) {
+  GLFWwindow *const window = Init();
 
-    glClearColor(0.9, 0.9, 0.9, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  if (window == GL_FALSE) {
+    return 1;
+  };
 
-    pongGame.update();
-    pongGame.draw();
+  // the glyphs are rendered in parallel instead of when first shown
+  Pong::prewarm();
+  Assets::Loader::finish();
+  Pong pongGame{Utf8::decode(lp), Utf8::decode(rp), config, seed};
+  if (recording) {
+    pongGame.replay(std::move(*recording));
+  }
+  if (!ConnectNetplay(pongGame, config)) {
+    return 1;
+  }
+  std::unique_ptr<Spectate::Server> spectators;
+  if (!StartSpectating(pongGame, spectators)) {
+    return 1;
+  }
+  // PONG_REPLAY_SPEED=<n> runs the simulation n times faster than real time
+  double speed = 1.0;
+  if (auto speedEnv = std::getenv("PONG_REPLAY_SPEED")) {
+    std::string_view value{speedEnv};
+    auto [end, error] =
+        std::from_chars(value.data(), value.data() + value.size(), speed);
+    if (error != std::errc{} || end != value.data() + value.size() ||
+        !std::isfinite(speed) || speed <= 0) {
+      std::cerr << "PONG_REPLAY_SPEED must be a positive number, got "
+                << value << std::endl;
+      return 1;
+    }
+  }
 
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+  glfwSetWindowSizeCallback(window, Window::onResize);
+
+  const std::chrono::duration<double> tick{pongGame.getTickDuration() / speed};
+#ifdef _WIN32
+  timeBeginPeriod(1); // sleeps are only as precise as the system timer
+#endif
+  std::atomic<bool> running{true};
+  std::thread simulation{RunSimulation, std::ref(pongGame), spectators.get(),
+                         tick, std::cref(running)};
+
+  glfwMakeContextCurrent(nullptr); // the renderer takes it over
+  std::thread renderer{RunRenderer, window, std::ref(pongGame), tick,
+                       std::cref(running)};
+
+  // GLFW's events and keys have to be read on this thread. Waiting at most a
+  // tick for an event means every tick sees fresh keys, whatever the renderer
+  // is blocked on.
+  while (glfwWindowShouldClose(window) == GL_FALSE) {
+    glfwWaitEventsTimeout(tick.count());
+    pongGame.setInput(ReadKeyboard(window));
   }
+  running = false;
+  renderer.join();
+  simulation.join();
+  glfwMakeContextCurrent(window); // to release the GL objects
+#ifdef _WIN32
+  timeEndPeriod(1);
+#endif
+
+  SaveRecording(pongGame);
+  PrintStats();
   return 0;
 }
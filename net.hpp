@@ -0,0 +1,363 @@
+#pragma once
+
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "simulation.hpp"
+
+namespace Net {
+
+#ifdef _WIN32
+using socket_t = SOCKET;
+static constexpr socket_t invalidSocket = INVALID_SOCKET;
+#else
+using socket_t = int;
+static constexpr socket_t invalidSocket = -1;
+#endif
+
+// Keeps Winsock started while it lives. WSAStartup counts its calls, so each
+// socket holds its own, and every successful start is cleaned up once.
+class Winsock {
+public:
+  Winsock() {
+#ifdef _WIN32
+    WSADATA wsa;
+    started = WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+    if (!started) {
+      std::cerr << "can't initialize winsock" << std::endl;
+    }
+#endif
+  }
+  Winsock(const Winsock &) : Winsock() {}
+  Winsock &operator=(const Winsock &) { return *this; }
+
+  ~Winsock() {
+#ifdef _WIN32
+    if (started) {
+      WSACleanup();
+    }
+#endif
+  }
+
+  bool ok() const { return started; }
+
+private:
+  bool started = true;
+};
+
+inline void closeSocket(socket_t sock) {
+#ifdef _WIN32
+  closesocket(sock);
+#else
+  close(sock);
+#endif
+}
+
+inline void setNonBlocking(socket_t sock) {
+#ifdef _WIN32
+  u_long nonBlocking = 1;
+  ioctlsocket(sock, FIONBIO, &nonBlocking);
+#else
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+// Whether the last failed call only had to wait.
+inline bool wouldBlock() {
+#ifdef _WIN32
+  return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+  return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+inline bool resolve(const std::string &host, uint16_t port, int type,
+                    sockaddr_in &address) {
+  addrinfo hints{};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = type;
+  addrinfo *found = nullptr;
+  if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints,
+                  &found) != 0 ||
+      !found) {
+    std::cerr << "can't resolve " << host << std::endl;
+    return false;
+  }
+  std::memcpy(&address, found->ai_addr, sizeof(address));
+  freeaddrinfo(found);
+  return true;
+}
+
+inline bool bindPort(socket_t sock, uint16_t port) {
+  sockaddr_in local{};
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  local.sin_port = htons(port);
+  if (bind(sock, reinterpret_cast<sockaddr *>(&local), sizeof(local)) != 0) {
+    std::cerr << "can't bind port " << port << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Non-blocking UDP socket talking to a single peer. Datagrams from any other
+// address are dropped, so only the peer can send inputs.
+class UdpSocket {
+public:
+  UdpSocket() {}
+
+  UdpSocket(const UdpSocket &) = delete;
+  UdpSocket &operator=(const UdpSocket &) = delete;
+
+  ~UdpSocket() {
+    if (sock != invalidSocket) {
+      closeSocket(sock);
+    }
+  }
+
+  bool open(uint16_t localPort, const std::string &host, uint16_t port) {
+    if (!winsock.ok() || !resolve(host, port, SOCK_DGRAM, peer)) {
+      return false;
+    }
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == invalidSocket) {
+      std::cerr << "can't create a UDP socket" << std::endl;
+      return false;
+    }
+    if (!bindPort(sock, localPort)) {
+      return false;
+    }
+    setNonBlocking(sock);
+    return true;
+  }
+
+  void send(std::span<const uint8_t> data) {
+    sendto(sock, reinterpret_cast<const char *>(data.data()), data.size(), 0,
+           reinterpret_cast<const sockaddr *>(&peer), sizeof(peer));
+  }
+
+  // Size of the peer's datagram read into buffer, or 0 when none is waiting.
+  size_t receive(std::span<uint8_t> buffer) {
+    while (true) {
+      sockaddr_in from{};
+      socklen_t fromSize = sizeof(from);
+      auto n = recvfrom(sock, reinterpret_cast<char *>(buffer.data()),
+                        buffer.size(), 0, reinterpret_cast<sockaddr *>(&from),
+                        &fromSize);
+      if (n <= 0) {
+        return 0;
+      }
+      if (from.sin_addr.s_addr == peer.sin_addr.s_addr &&
+          from.sin_port == peer.sin_port) {
+        return static_cast<size_t>(n);
+      }
+    }
+  }
+
+private:
+  Winsock winsock;
+  socket_t sock = invalidSocket;
+  sockaddr_in peer{};
+};
+
+// UdpSocket that can hold back and drop outgoing datagrams, to try netplay
+// over loopback with the latency and loss of a real connection.
+class Link {
+public:
+  bool open(uint16_t localPort, const std::string &host, uint16_t port) {
+    return socket.open(localPort, host, port);
+  }
+
+  // One way delay of every datagram, plus up to `jitter` more.
+  void setLatency(std::chrono::milliseconds delay,
+                  std::chrono::milliseconds jitter = {}) {
+    latency = delay;
+    this->jitter = jitter;
+  }
+  // Probability in [0, 1] that a datagram is lost.
+  void setLoss(float probability) { loss = probability; }
+
+  void send(std::span<const uint8_t> data) {
+    if (loss > 0 && Sim::getRandomf(rng, 0, 1) < loss) {
+      return;
+    }
+    if (latency.count() == 0 && jitter.count() == 0) {
+      socket.send(data);
+      return;
+    }
+    auto delay = latency + std::chrono::milliseconds(static_cast<int>(
+                               Sim::getRandomf(rng, 0, jitter.count())));
+    delayed.push_back(
+        Delayed{clock::now() + delay, {data.begin(), data.end()}});
+  }
+
+  // Sends the held back datagrams that are due. Call every frame.
+  void poll() {
+    auto now = clock::now();
+    for (auto it = delayed.begin(); it != delayed.end();) {
+      if (it->due <= now) {
+        socket.send(it->data);
+        it = delayed.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  size_t receive(std::span<uint8_t> buffer) { return socket.receive(buffer); }
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  struct Delayed {
+    clock::time_point due;
+    std::vector<uint8_t> data;
+  };
+
+  UdpSocket socket;
+  std::chrono::milliseconds latency{0}, jitter{0};
+  float loss = 0;
+  uint32_t rng = 0x9E3779B9u;
+  std::deque<Delayed> delayed;
+};
+
+// Non-blocking TCP stream.
+class TcpSocket {
+public:
+  TcpSocket() {}
+  TcpSocket(socket_t sock) : sock{sock} {}
+
+  TcpSocket(TcpSocket &&other) : sock{other.sock} {
+    other.sock = invalidSocket;
+  }
+  TcpSocket &operator=(TcpSocket &&other) {
+    std::swap(sock, other.sock);
+    return *this;
+  }
+  TcpSocket(const TcpSocket &) = delete;
+  TcpSocket &operator=(const TcpSocket &) = delete;
+
+  ~TcpSocket() {
+    if (sock != invalidSocket) {
+      closeSocket(sock);
+    }
+  }
+
+  // Connecting blocks; the connected socket doesn't.
+  bool connect(const std::string &host, uint16_t port) {
+    sockaddr_in address;
+    if (!winsock.ok() || !resolve(host, port, SOCK_STREAM, address)) {
+      return false;
+    }
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock == invalidSocket ||
+        ::connect(sock, reinterpret_cast<sockaddr *>(&address),
+                  sizeof(address)) != 0) {
+      std::cerr << "can't connect to " << host << ':' << port << std::endl;
+      return false;
+    }
+    setNonBlocking(sock);
+    return true;
+  }
+
+  // Bytes written, 0 when the socket would block, -1 when it's broken.
+  long send(std::span<const uint8_t> data) {
+#ifdef MSG_NOSIGNAL
+    constexpr int flags = MSG_NOSIGNAL;
+#else
+    constexpr int flags = 0;
+#endif
+    auto n = ::send(sock, reinterpret_cast<const char *>(data.data()),
+                    data.size(), flags);
+    if (n < 0) {
+      return wouldBlock() ? 0 : -1;
+    }
+    return n;
+  }
+
+  // Bytes read, 0 when nothing is waiting, -1 when the stream ended.
+  long receive(std::span<uint8_t> buffer) {
+    auto n = recv(sock, reinterpret_cast<char *>(buffer.data()), buffer.size(),
+                  0);
+    if (n < 0) {
+      return wouldBlock() ? 0 : -1;
+    }
+    return n == 0 ? -1 : n;
+  }
+
+  bool valid() const { return sock != invalidSocket; }
+
+private:
+  Winsock winsock;
+  socket_t sock = invalidSocket;
+};
+
+// Non-blocking listening TCP socket.
+class TcpListener {
+public:
+  TcpListener() {}
+
+  TcpListener(const TcpListener &) = delete;
+  TcpListener &operator=(const TcpListener &) = delete;
+
+  ~TcpListener() {
+    if (sock != invalidSocket) {
+      closeSocket(sock);
+    }
+  }
+
+  bool listen(uint16_t port) {
+    if (!winsock.ok()) {
+      return false;
+    }
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock == invalidSocket) {
+      std::cerr << "can't create a TCP socket" << std::endl;
+      return false;
+    }
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR,
+               reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+    if (!bindPort(sock, port) || ::listen(sock, SOMAXCONN) != 0) {
+      return false;
+    }
+    setNonBlocking(sock);
+    return true;
+  }
+
+  // A waiting connection, or an invalid socket when there is none.
+  TcpSocket accept() {
+    auto client = ::accept(sock, nullptr, nullptr);
+    if (client == invalidSocket) {
+      return {};
+    }
+    setNonBlocking(client);
+    return TcpSocket{client};
+  }
+
+private:
+  Winsock winsock;
+  socket_t sock = invalidSocket;
+};
+
+} // namespace Net
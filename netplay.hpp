@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "net.hpp"
+#include "rollback.hpp"
+
+// Sim::Rollback over a Net::Link. Every datagram carries all local inputs the
+// peer hasn't acknowledged yet, so a lost datagram costs nothing but delay.
+//
+// Datagram, little endian:
+//   magic u32, seed u32, ack u32 (every input of the sender's peer before it
+//   has arrived), first u32, count u8, count input bytes from tick first.
+class NetSession {
+public:
+  static constexpr uint32_t magic = 0x504e4750; // "PGNP"
+
+  NetSession(Sim::Side side, float aspect, uint32_t seed,
+             Sim::Config config = {})
+      : rollback{side, aspect, seed, config}, seed{seed} {}
+
+  Net::Link &getLink() { return link; }
+
+  // Exchanges input with the peer and simulates the next tick. Returns false
+  // when waiting for the peer.
+  bool update(uint8_t localInput) {
+    receive();
+    auto advanced = rollback.advance(localInput);
+    send();
+    link.poll();
+    return advanced;
+  }
+
+  // Exchanges input without simulating a new tick.
+  void poll() {
+    receive();
+    rollback.resimulate();
+    send();
+    link.poll();
+  }
+
+  const Sim::Rollback &getRollback() const { return rollback; }
+  const Sim::State &getState() const { return rollback.getState(); }
+
+private:
+  static constexpr size_t headerSize = 17;
+
+  static void put32(std::vector<uint8_t> &out, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+      out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+  }
+  static uint32_t get32(const uint8_t *in) {
+    return in[0] | in[1] << 8 | in[2] << 16 |
+           static_cast<uint32_t>(in[3]) << 24;
+  }
+
+  void send() {
+    auto first = peerAck;
+    auto count = std::min<uint32_t>(rollback.getTick() - first, 255);
+
+    packet.clear();
+    put32(packet, magic);
+    put32(packet, seed);
+    put32(packet, rollback.getRemoteConfirmed());
+    put32(packet, first);
+    packet.push_back(static_cast<uint8_t>(count));
+    for (uint32_t i = 0; i < count; i++) {
+      packet.push_back(rollback.getLocalInput(first + i));
+    }
+    link.send(packet);
+  }
+
+  void receive() {
+    uint8_t buffer[headerSize + 255];
+    while (auto size = link.receive(buffer)) {
+      if (size < headerSize || get32(buffer) != magic ||
+          get32(buffer + 4) != seed) {
+        continue;
+      }
+      auto ack = get32(buffer + 8);
+      auto first = get32(buffer + 12);
+      auto count = std::min<size_t>(buffer[16], size - headerSize);
+      if (first + count > rollback.getTick() + Sim::Rollback::window) {
+        continue; // the peer can't be this far ahead
+      }
+
+      peerAck = std::clamp(ack, peerAck, rollback.getTick());
+      rollback.acknowledge(peerAck);
+      for (size_t i = 0; i < count; i++) {
+        rollback.addRemoteInput(first + i, buffer[headerSize + i]);
+      }
+    }
+  }
+
+  Sim::Rollback rollback;
+  Net::Link link;
+  uint32_t seed;
+  uint32_t peerAck = 0; // the peer has every local input before this tick
+  std::vector<uint8_t> packet;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include "shapes.hpp"
+#include "simulation.hpp"
+#include "traits.hpp"
+
+// Drawables of the match's moving objects, placed from their Sim state.
+
+class Paddle : public Drawable, public Animatable<const Sim::PaddleState &> {
+public:
+  Paddle(float width, float height, auto &&color)
+      : width{width}, height{height},
+        color{std::forward<decltype(color)>(color)} {}
+
+  virtual void update(const Sim::PaddleState &state) override {
+    rct.update({state.x, state.y}, width, height);
+  }
+
+  virtual void draw() override { rct.draw(); }
+
+private:
+  float width, height;
+  glm::vec3 color;
+
+  Shapes::Rectangle rct{glm::vec2{0, 0}, width, height, color};
+};
+
+class Ball : public Drawable, public Animatable<const Sim::BallState &> {
+public:
+  Ball(float width)
+      : rect{glm::vec2{0, 0}, width, width, glm::vec3{0.2, 0.2, 0.2}},
+        width{width} {}
+
+  virtual void draw() override { rect.draw(); }
+
+  virtual void update(const Sim::BallState &state) override {
+    rect.update(glm::vec2{state.x, state.y}, width, width);
+  }
+
+private:
+  Shapes::Rectangle rect;
+  float width;
+};
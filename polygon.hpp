@@ -18,18 +18,16 @@
 #include <glm/glm.hpp>
 
 #include "buffer.hpp"
+#include "render.hpp"
 #include "shader.hpp"
 #include "traits.hpp"
-#include "window.hpp"
 
 namespace Shapes {
 class Polygon : public Animatable<std::span<glm::vec3>, std::span<glm::vec3>>,
                 public Drawable {
 public:
-  static inline const std::string fragmentshaderPath{
-      "../shaders/identity/identity.frag"};
-  static inline const std::string vertexShaderPath{
-      "../shaders/identity/identity.vert"};
+  static inline const std::string fragmentshaderPath{"identity/identity.frag"};
+  static inline const std::string vertexShaderPath{"identity/identity.vert"};
 
   using vertex_t = glm::vec3;
   using color_t = glm::vec3;
@@ -40,13 +38,6 @@ public:
   Polygon(size_t verticesSize, size_t colorSize)
       : vertexArray{verticesSize}, colorArray{colorSize},
         verticesSize(verticesSize) {
-    Shader vertexShader{vertexShaderPath, GL_VERTEX_SHADER};
-    Shader fragmentShader{fragmentshaderPath, GL_FRAGMENT_SHADER};
-
-    vertexShader.compile();
-    fragmentShader.compile();
-
-    shader = ShaderProgram{vertexShader, fragmentShader};
     initShaderInput();
   }
 
@@ -55,22 +46,18 @@ public:
              std::is_array_v<std::remove_reference_t<decltype(colorVec)>>)
       : verticesSize{std::size(vertices)}, vertexArray{vertices},
         colorArray{colorVec}, array{} {
-
-    Shader vertexShader{vertexShaderPath, GL_VERTEX_SHADER};
-    Shader fragmentShader{fragmentshaderPath, GL_FRAGMENT_SHADER};
-
-    vertexShader.compile();
-    fragmentShader.compile();
-
     initShaderInput();
   }
 
   virtual void draw() override {
-    array.bind();
-    shader.use();
-    glUniform1f(2, Window::getAspect());
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, verticesSize);
-    array.unbind();
+    RenderQueue::submit(
+        {RenderQueue::world, *shader, 0, array.getHandle()}, "Polygon", this,
+        [](void *object, const RenderQueue::Args &) {
+          auto &self = *static_cast<Polygon *>(object);
+          self.array.bind();
+          self.shader->use();
+          glDrawArrays(GL_TRIANGLE_STRIP, 0, self.verticesSize);
+        });
   }
 
   virtual void update(vertices_t vertices, colors_t colors) override {
@@ -91,14 +78,13 @@ private:
 
     array.vertexArrayAttribBinding(0, 0);
     array.vertexArrayAttribBinding(1, 1);
-
-    shader.use();
-    glUniform1f(2, Window::getAspect());
   }
 
   size_t verticesSize = 0;
 
-  ShaderProgram shader;
+  std::shared_ptr<ShaderProgram> shader{
+      ShaderProgram::get({{vertexShaderPath, GL_VERTEX_SHADER},
+                          {fragmentshaderPath, GL_FRAGMENT_SHADER}})};
 
   ArrayBuffer<vertex_t> vertexArray;
   ArrayBuffer<color_t> colorArray;
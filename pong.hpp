@@ -1,349 +1,248 @@
 #pragma once
 
-#include <bitset>
-#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <cwchar>
-#include <map>
+#include <iostream>
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <tuple>
 
-#include <windows.h>
-
+#include "netplay.hpp"
+#include "objects.hpp"
+#include "render.hpp"
+#include "replay.hpp"
 #include "shapes.hpp"
+#include "simulation.hpp"
+#include "spectate.hpp"
 #include "string.hpp"
+#include "triplebuffer.hpp"
 
-class Paddle : public Drawable,
-               public Animatable<bool, bool>,
-               public Animatable<float> {
+class Pong : public Drawable, public Animatable<>, public Animatable<float> {
 public:
-  Paddle(float x, float y, float width, float height, auto &&color)
-      : x{x}, y{y}, width{width}, height{height},
-        color{std::forward<decltype(color)>(color)} {}
-
-  virtual void update(bool up, bool down) override {
-
-    if (up && y < 1 - (height / 2)) {
-      y += speed;
-      moving = true;
-      return;
-    } else if (down && y > -1 + (height / 2)) {
-      y -= speed;
-      moving = true;
-    } else {
-      moving = false;
-    }
-    rct.update({x, y}, width, height);
-    return;
+  Pong(std::wstring playerNameL, std::wstring playerNameR,
+       Sim::Config config = {}, uint32_t seed = 1)
+      : rPlayer(playerNameR), lPlayer(playerNameL),
+        match{Window::getAspect(), seed, config},
+        recorder{seed, Window::getAspect(), config},
+        leftPlayerScoreStr(font, L"0", scoreSize, glm::vec3{0.2, 0.2, 0.2},
+                           glm::vec2{-0.75, 0.8}, String::center),
+        rightPlayerScoreStr(font, L"0", scoreSize, glm::vec3{0.2, 0.2, 0.2},
+                            glm::vec2{0.75, 0.8}, String::center),
+        msgGAMEOVER(font, L"", gameOverSize, glm::vec3{0.2, 0.2, 0.2},
+                    glm::vec2{0, 0.2}, String::center),
+        msgRestart(font, L"", restartSize, glm::vec3{0.2, 0.2, 0.2},
+                   glm::vec2{0, -0.15}, String::center) {
+    previousState = match.getState();
+    publish();
+    update(1.0f);
   }
 
-  virtual void update(float aspect) override {
-    if (x > 0) {
-      rct.update({0.9 * aspect, y}, width, height);
-      x = 0.9 * aspect;
-    } else {
-      rct.update({-0.9 * aspect, y}, width, height);
-      x = -0.9 * aspect;
-    }
-    return;
-  }
-
-  virtual void draw() override { rct.draw(); }
-
-  std::tuple<float, float> getPos() { return {x, y}; }
-  std::tuple<float, float> getSize() { return {width, height}; }
-  bool isMoving() { return moving; }
-
-private:
-  float x, y, width, height;
-  glm::vec3 color;
-  float speed = 0.015;
-  bool moving = false;
-
-  Shapes::Rectangle rct{glm::vec2{x, y}, width, height, color};
-};
-
-class Ball : public Drawable,
-             public Animatable<>,
-             public Animatable<Paddle &, Paddle &>,
-             public Animatable<float, float, glm::vec2>,
-             public Animatable<float, float> {
-
-public:
-  Ball(float x, float y, float width, auto &&speed)
-      : rect{glm::vec2{x, y}, width, width, glm::vec3{0.2, 0.2, 0.2}},
-        speed{std::forward<decltype(speed)>(speed)}, x{x}, y{y}, width{width} {}
-
-  virtual void draw() override {
-    rect.update(glm::vec2{x, y}, width, width);
-    rect.draw();
+  // Starts rendering every glyph the match can show on the asset workers.
+  // Call before constructing a Pong, then Assets::Loader::finish().
+  static void prewarm() {
+    auto mode = String::defaultMode;
+    Character::prewarm(font, scoreSize, L"0123456789", mode);
+    Character::prewarm(font, gameOverSize, gameOverText, mode);
+    Character::prewarm(font, restartSize, restartText, mode);
   }
 
+  // Advances the simulation by one fixed tick, with the keyboard's input or
+  // the replayed one. Every tick is recorded either way. The simulation side
+  // only touches the match and publishes it; it may run on its own thread.
   virtual void update() override {
-    x += speed.x;
-    y += speed.y;
-    if (y + (width / 2) > 1 || y - (width / 2) < -1) {
-      speed.y *= -1;
-    };
-  }
-
-  virtual void update(Paddle &rPaddle, Paddle &lPaddle) override {
-    auto &&[lx, ly] = lPaddle.getPos();
-    auto &&[lw, lh] = lPaddle.getSize();
-
-    auto &&[rx, ry] = rPaddle.getPos();
-    auto &&[rw, rh] = rPaddle.getSize();
-
-    auto topY = y + (width / 2);
-    auto bottomY = y - (width / 2);
-
-    // left paddle
-    auto isBallInLeftPaddleXrange = x - (width / 2) < lx + (lw / 2);
-
-    auto isBallInLeftPaddleYrange =
-        ly - (lh / 2) < topY && topY < ly + (lh / 2) ||
-        ly - (lh / 2) < bottomY && bottomY < ly + (lh / 2);
-
-    auto isBallInRightPaddleXrange = rx - (rw / 2) < x + (width / 2);
-
-    auto isBallInRightPaddleYrange =
-        ry - (rh / 2) < topY && topY < ry + (rh / 2) ||
-        ry - (rh / 2) < bottomY && bottomY < ry + (rh / 2);
-
-    if (isBallInLeftPaddleXrange && isBallInLeftPaddleYrange) {
-      if (lPaddle.isMoving()) {
-        speed.y += getRandomf(-0.005, 0.005);
-      }
-
-      if (speed.x < 0.0f) {
-        speed.x *= -1;
+    previousState = getState();
+    if (net) {
+      net->update(keyboard);
+      publish();
+      return;
+    }
+    if (viewer) {
+      if (!viewer->update() && !viewer->isConnected() && !viewerLost) {
+        // the last tick received stays on screen
+        std::cerr << "lost the connection to the spectated match" << std::endl;
+        viewerLost = true;
       }
+      publish();
+      return;
     }
 
-    if (isBallInRightPaddleXrange && isBallInRightPaddleYrange) {
-      if (rPaddle.isMoving()) {
-        speed.y += getRandomf(-0.005, 0.005);
-      }
-      if (speed.x > 0.0f) {
-        speed.x *= -1;
-      }
+    uint8_t input;
+    float aspect;
+    if (player) {
+      input = player->next();
+      aspect = player->getAspect();
+    } else {
+      input = keyboard;
+      aspect = Window::getAspect();
     }
-  }
+    recorder.setAspect(aspect);
+    recorder.record(input);
 
-  virtual void update(float x, float y, glm::vec2 speed) override {
-    this->x = x;
-    this->y = y;
-    this->speed = speed;
+    match.setAspect(aspect);
+    match.step(Sim::unpackInput(input));
+    publish();
   }
 
-  virtual void update(float x, float y) override {
-    this->x = x;
-    this->y = y;
+  // Restarts the match from a recording and takes the input from it. Pong
+  // should be constructed with the recording's config, which sizes the
+  // paddles and the ball.
+  void replay(Sim::Recording recording) {
+    match = Sim::Match{recording.aspect, recording.seed, recording.config};
+    recorder = Sim::Recorder{recording.seed, recording.aspect,
+                             recording.config};
+    previousState = match.getState();
+    player.emplace(std::move(recording));
+    publish();
+    update(1.0f);
   }
 
-  std::tuple<float, float> getPos() { return {x, y}; }
+  bool replayFinished() const { return player && player->done(); }
 
-private:
-  Shapes::Rectangle rect;
-  float x, y;
-  float width;
-
-  glm::vec2 speed;
-
-  inline float getRandomf(float min, float max) {
-    return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+  // Plays against the peer of the session from now on. The session's match
+  // replaces the local one; it should have been made with this Pong's config.
+  void connect(std::unique_ptr<NetSession> session) {
+    net = std::move(session);
+    previousState = getState();
+    publish();
+    update(1.0f);
   }
-};
-
-class Pong : public Drawable, public Animatable<> {
-private:
-  enum gameState { beginGame, gamePlaying, attackPlayer, goal, over };
-
-  gameState currentGameState = gameState::beginGame;
 
-public:
-  Pong(std::wstring playerNameL, std::wstring playerNameR)
-      : rPlayer(playerNameR), lPlayer(playerNameL),
-        leftPlayerScoreStr("../fonts/NotoSansJP-Bold.otf", L"0",
-                           Ft2Wrap::getPoint(10, 0), glm::vec3{0.2, 0.2, 0.2},
-                           glm::vec2{-0.75, 0.8}, String::center),
-        rightPlayerScoreStr("../fonts/NotoSansJP-Bold.otf", L"0",
-                            Ft2Wrap::getPoint(10, 0), glm::vec3{0.2, 0.2, 0.2},
-                            glm::vec2{0.75, 0.8}, String::center),
-        msgGAMEOVER("../fonts/NotoSansJP-Bold.otf", L"",
-                    Ft2Wrap::getPoint(12, 0), glm::vec3{0.2, 0.2, 0.2},
-                    glm::vec2{0, 0.2}, String::center),
-        msgRestart("../fonts/NotoSansJP-Bold.otf", L"", Ft2Wrap::getPoint(5, 0),
-                   glm::vec3{0.2, 0.2, 0.2}, glm::vec2{0, -0.15},
-                   String::center) {
-    player[playerNameL] = 0;
-    player[playerNameR] = 0;
+  // Shows a match streamed by a Spectate::Server instead of playing.
+  void watch(std::unique_ptr<Spectate::Client> client) {
+    viewer = std::move(client);
+    previousState = getState();
+    publish();
+    update(1.0f);
   }
 
-  virtual void update() override {
-    using enum Pong::gameState;
-    switch (currentGameState) {
-    case beginGame:
-      begin();
-      break;
-    case gamePlaying:
-      playing();
-      break;
-    case attackPlayer:
-      playerAttack();
-      break;
-    case goal:
-      ballGoaled();
-      break;
-    case over:
-      gameOver();
-    }
-  }
-  virtual void draw() override {
-    for (auto &e : objects) {
-      e->draw();
+  const Sim::State &getState() const {
+    if (viewer) {
+      return viewer->getState();
     }
+    return net ? net->getState() : match.getState();
   }
 
-private:
-  void playing() {
-    ball.update(rPaddle, lPaddle);
-    ball.update();
-    movePaddle();
-
-    auto &&ballX = std::get<0>(ball.getPos());
-    auto &&rPaddleX = std::get<0>(rPaddle.getPos());
-    auto &&lPaddleX = std::get<0>(lPaddle.getPos());
-
-    if (rPaddleX < ballX) {
-      setGameState(goal);
-    } else if (ballX < lPaddleX) {
-      setGameState(goal);
-    }
+  const Sim::Recording &getRecording() const {
+    return recorder.getRecording();
   }
 
-  void begin() {
-    movePaddle();
-    bool spacePressed = keyPresssed(VK_SPACE);
-    if (spacePressed) {
-      float v = ((float)rand() / (float)RAND_MAX) * 2;
-      if (v > 1.0f) {
-        ball.update(0, 0, glm::vec2{ballSpeed, 0});
-      } else {
-        ball.update(0, 0, glm::vec2{-ballSpeed, 0});
-      }
-      ball.update();
-      setGameState(gamePlaying);
-    }
+  // Places the drawables between the two ticks of the latest snapshot; alpha
+  // is the fraction of a tick elapsed since the later one.
+  virtual void update(float alpha) override {
+    show(snapshots.acquire(), alpha);
   }
 
-  void gameOver() {
-    msgGAMEOVER.update(L"GAMEOVER");
-    msgRestart.update(L"(press space to restart game)");
-    ball.update(0, 0);
-
-    if (keyPresssed(VK_SPACE)) {
-      msgGAMEOVER.update(L"");
-      msgRestart.update(L"");
-      setGameState(beginGame);
-      for (auto &&e : player) {
-        auto &&[_, score] = e;
-        score = 0;
-      }
-      rightPlayerScoreStr.update(std::to_wstring(player[rPlayer]));
-      leftPlayerScoreStr.update(std::to_wstring(player[lPlayer]));
-    }
+  // update(alpha) with alpha from the time the latest snapshot was published,
+  // for a simulation running on another thread every `tick`.
+  void present(std::chrono::duration<double> tick) {
+    auto &snapshot = snapshots.acquire();
+    auto alpha = (clock::now() - snapshot.time) / tick;
+    show(snapshot, static_cast<float>(std::clamp(alpha, 0.0, 1.0)));
   }
 
-  void playerAttack() {
-    movePaddle();
-    auto &&[ballX, ballY] = ball.getPos();
-    float dx = 0.15;
-    if (ballX < 0.0f) { // goaled to left side
-      auto &&[px, py] = lPaddle.getPos();
-      ball.update(px + dx, py);
-      if (keyPresssed(VK_SPACE)) {
-        ball.update(px + dx, py, glm::vec2{ballSpeed, 0});
-        setGameState(gamePlaying);
-      }
-    } else if (0.0f < ballX) { // goaled to right side
-      auto &&[px, py] = rPaddle.getPos();
-      ball.update(px - dx, py);
-      if (keyPresssed(VK_SPACE)) {
-        ball.update(px - dx, py, glm::vec2{-ballSpeed, 0});
-        setGameState(gamePlaying);
-      }
-    }
+  // Keys held in the window, for the ticks from now on. Sampled on the
+  // thread polling the window's events, which only sees them while the
+  // window has focus; headless runs never set any.
+  void setInput(const Sim::Input &input) {
+    keyboard = Sim::packInput(input);
   }
 
-  void movePaddle() {
-    bool oPressed = keyPresssed(0x4F); // up rirght paddle O
-    bool lPressed = keyPresssed(0x4C); // down right paddle L
-
-    bool ePressed = keyPresssed(0x51); // up left paddle Q
-    bool dPressed = keyPresssed(0x41); // down left paddle A
+  float getTickDuration() const { return match.getConfig().getTickDuration(); }
 
-    rPaddle.update(oPressed, lPressed);
-    lPaddle.update(ePressed, dPressed);
+  virtual void draw() override {
+    for (auto &e : shapes) {
+      e->draw();
+    }
+    Shapes::QuadBatch::flush();
 
-    for (auto &e : {&rPaddle, &lPaddle}) {
-      e->update(Window::getAspect());
+    for (auto &e : texts) {
+      e->draw();
     }
+    RenderQueue::flush();
   }
 
-  void ballGoaled() {
-    movePaddle();
-    auto &&[ballX, ballY] = ball.getPos();
-    float dx = 0.15;
-    if (ballX < 0.0f) { // goaled to left side
-      player[rPlayer] += 1;
-      rightPlayerScoreStr.update(std::to_wstring(player[rPlayer]));
-
-    } else if (0.0f < ballX) { // goaled to right side
-      player[lPlayer] += 1;
-      leftPlayerScoreStr.update(std::to_wstring(player[lPlayer]));
+private:
+  using clock = std::chrono::steady_clock;
+
+  static inline const std::string font{"../fonts/NotoSansJP-Bold.otf"};
+  static inline const FT_F26Dot6 scoreSize = Ft2Wrap::getPoint(10, 0);
+  static inline const FT_F26Dot6 gameOverSize = Ft2Wrap::getPoint(12, 0);
+  static inline const FT_F26Dot6 restartSize = Ft2Wrap::getPoint(5, 0);
+  static constexpr const wchar_t *gameOverText = L"GAMEOVER";
+  static constexpr const wchar_t *restartText =
+      L"(press space to restart game)";
+
+  // What drawing needs of a tick, copied out of the simulation.
+  struct Snapshot {
+    Sim::State previous, current;
+    clock::time_point time;
+  };
+
+  void publish() {
+    auto &snapshot = snapshots.back();
+    snapshot.previous = previousState;
+    snapshot.current = getState();
+    snapshot.time = clock::now();
+    snapshots.publish();
+  }
+
+  void show(const Snapshot &snapshot, float alpha) {
+    auto &&state = Sim::interpolate(snapshot.previous, snapshot.current, alpha);
+    ball.update(state.ball);
+    rPaddle.update(state.rPaddle);
+    lPaddle.update(state.lPaddle);
+    mirrorText(snapshot.current);
+  }
+
+  void mirrorText(const Sim::State &state) {
+    if (state.lScore != shownLScore) {
+      shownLScore = state.lScore;
+      leftPlayerScoreStr.update(std::to_wstring(shownLScore));
     }
-    if (player[lPlayer] < matchPoint && player[rPlayer] < matchPoint) {
-      setGameState(attackPlayer);
-    } else {
-      setGameState(over);
+    if (state.rScore != shownRScore) {
+      shownRScore = state.rScore;
+      rightPlayerScoreStr.update(std::to_wstring(shownRScore));
     }
-  }
-
-  inline void setGameState(Pong::gameState state) { currentGameState = state; }
 
-  inline bool keyPresssed(int virtualKey) {
-    return GetKeyState(virtualKey) & 0x8000;
+    bool isOver = state.gameState == Sim::GameState::over;
+    if (isOver != shownOver) {
+      shownOver = isOver;
+      msgGAMEOVER.update(isOver ? gameOverText : L"");
+      msgRestart.update(isOver ? restartText : L"");
+    }
   }
 
-  float ballSpeed = 0.02;
-  float paddleWidth = 0.1;
-  float paddleHeight = 0.3;
-  float ballWidth = 0.15;
-
-  const int matchPoint = 12;
-
-  glm::vec3 paddleColor{0.2, 0.2, 0.2};
-
-  Ball ball{0, 0, ballWidth, glm::vec2{ballSpeed, 0}};
-
-  Paddle rPaddle{0.9f * Window::getAspect(), 0, paddleWidth, paddleHeight,
-                 paddleColor};
-  Paddle lPaddle{-0.9f * Window::getAspect(), 0, paddleWidth, paddleHeight,
-                 paddleColor};
+  std::wstring lPlayer, rPlayer;
+  std::atomic<uint8_t> keyboard{0}; // packed Sim::Input
+
+  Sim::Match match;
+  Sim::State previousState;
+  Sim::Recorder recorder;
+  std::optional<Sim::Player> player;
+  std::unique_ptr<NetSession> net;
+  std::unique_ptr<Spectate::Client> viewer;
+  bool viewerLost = false;
+  TripleBuffer<Snapshot> snapshots;
+
+  Ball ball{match.getConfig().ballWidth};
+
+  Paddle rPaddle{match.getConfig().paddleWidth, match.getConfig().paddleHeight,
+                 glm::vec3{0.2, 0.2, 0.2}};
+  Paddle lPaddle{match.getConfig().paddleWidth, match.getConfig().paddleHeight,
+                 glm::vec3{0.2, 0.2, 0.2}};
   String leftPlayerScoreStr, rightPlayerScoreStr;
   String msgGAMEOVER;
   String msgRestart;
 
-  Drawable *objects[7]{&ball,
-                       &rPaddle,
-                       &lPaddle,
-                       &leftPlayerScoreStr,
-                       &rightPlayerScoreStr,
-                       &msgGAMEOVER,
-                       &msgRestart};
-
-  std::wstring lPlayer, rPlayer;
+  Drawable *shapes[3]{&ball, &rPaddle, &lPaddle};
+  Drawable *texts[4]{&leftPlayerScoreStr, &rightPlayerScoreStr, &msgGAMEOVER,
+                     &msgRestart};
 
-  std::map<std::wstring, int> player;
+  int shownLScore = 0, shownRScore = 0;
+  bool shownOver = false;
 };
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "handle.hpp"
+
+// GPU time of named sections, measured with GL_TIMESTAMP queries. A frame's
+// queries are read `frames` frames later, when the GPU is done with them, so
+// collecting results never waits; results that still aren't ready by then are
+// dropped. Sections may nest. Names must outlive the frame (use literals).
+//
+// A section can belong to an object, e.g. the Drawable that submitted a
+// draw. Its time is then kept per object, as "name#n" with n counting the
+// objects seen under that name, and summed under the bare name as well.
+class GpuProfiler {
+public:
+  static constexpr size_t frames = 3;
+
+  struct Stats {
+    double lastMs = 0, totalMs = 0, maxMs = 0;
+    size_t samples = 0;
+  };
+
+  class Scope {
+  public:
+    Scope(std::string_view name, const void *object = nullptr) {
+      begin(name, object);
+    }
+    ~Scope() { end(); }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+
+  static inline void setEnabled(bool enable) { enabled = enable; }
+  static inline bool isEnabled() { return enabled; }
+
+  static inline void begin(std::string_view name,
+                           const void *object = nullptr) {
+    if (!enabled) {
+      return;
+    }
+    if (ring.empty()) {
+      ring.resize(frames);
+    }
+    auto &frame = ring[current];
+    if (frame.used == frame.samples.size()) {
+      frame.samples.emplace_back();
+    }
+    auto &sample = frame.samples[frame.used];
+    sample.name = name;
+    sample.object = object;
+    glQueryCounter(sample.start, GL_TIMESTAMP);
+    open.push_back(frame.used++);
+  }
+
+  static inline void end() {
+    if (!enabled || open.empty()) {
+      return;
+    }
+    glQueryCounter(ring[current].samples[open.back()].end, GL_TIMESTAMP);
+    open.pop_back();
+  }
+
+  // Call once per frame after the last section. Collects the oldest frame.
+  static inline void endFrame() {
+    if (!enabled || ring.empty()) {
+      return;
+    }
+    open.clear();
+    current = (current + 1) % frames;
+    collect(ring[current]);
+  }
+
+  static inline const std::map<std::string, Stats, std::less<>> &getStats() {
+    return stats;
+  }
+  static inline size_t getDropped() { return dropped; }
+
+  static inline void dump(std::ostream &stream) {
+    stream << "GPU time per section (ms):" << std::endl;
+    for (auto &&[name, e] : stats) {
+      stream << "  " << std::left << std::setw(14) << name << std::right
+             << std::fixed << std::setprecision(3)
+             << " avg " << e.totalMs / std::max<size_t>(e.samples, 1)
+             << " max " << e.maxMs << " samples " << e.samples << std::endl;
+    }
+    if (dropped > 0) {
+      stream << "  " << dropped << " samples not ready in time" << std::endl;
+    }
+  }
+
+private:
+  struct Sample {
+    std::string_view name;
+    const void *object;
+    QueryHandle start{GL_TIMESTAMP}, end{GL_TIMESTAMP};
+  };
+
+  struct Frame {
+    std::vector<Sample> samples;
+    size_t used = 0;
+  };
+
+  // Sections run several times in a frame count as one sample of their sum.
+  static inline void collect(Frame &frame) {
+    std::map<std::string_view, double> frameMs; // by label
+    for (size_t i = 0; i < frame.used; i++) {
+      auto &sample = frame.samples[i];
+      GLint available = 0;
+      glGetQueryObjectiv(sample.end, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available) {
+        dropped++;
+        continue;
+      }
+      GLuint64 start, end;
+      glGetQueryObjectui64v(sample.start, GL_QUERY_RESULT, &start);
+      glGetQueryObjectui64v(sample.end, GL_QUERY_RESULT, &end);
+      auto ms = static_cast<double>(end - start) / 1e6;
+      frameMs[sample.name] += ms;
+      if (sample.object) {
+        frameMs[label(sample.name, sample.object)] += ms;
+      }
+    }
+    frame.used = 0;
+
+    for (auto &&[name, ms] : frameMs) {
+      auto it = stats.find(name);
+      if (it == stats.end()) {
+        it = stats.emplace(std::string(name), Stats{}).first;
+      }
+      auto &e = it->second;
+      e.lastMs = ms;
+      e.totalMs += ms;
+      e.maxMs = std::max(e.maxMs, ms);
+      e.samples++;
+    }
+  }
+
+  static inline std::string_view label(std::string_view name,
+                                       const void *object) {
+    auto [it, inserted] = labels.try_emplace({name, object});
+    if (inserted) {
+      it->second = std::string(name) + "#" + std::to_string(++instances[name]);
+    }
+    return it->second;
+  }
+
+  static inline bool enabled = false;
+  static inline std::vector<Frame> ring{};
+  static inline size_t current = 0;
+  static inline std::vector<size_t> open{};
+
+  static inline std::map<std::string, Stats, std::less<>> stats{};
+  // objects are told apart by address
+  static inline std::map<std::pair<std::string_view, const void *>,
+                         std::string>
+      labels{};
+  static inline std::map<std::string_view, size_t> instances{};
+  static inline size_t dropped = 0;
+};
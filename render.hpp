@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <compare>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "profiler.hpp"
+
+// Draw calls submitted during a frame. flush() runs them ordered by layer,
+// then program, texture and vertex array, so draws sharing state follow each
+// other and GLState drops the repeated binds. Draws with equal keys keep
+// their submission order. Each draw is timed by GpuProfiler under its name.
+// Commands are plain data, so queueing one never allocates once the queue
+// has grown to a frame's worth.
+class RenderQueue {
+public:
+  enum Layer : uint8_t { world, overlay };
+
+  struct Key {
+    Layer layer;
+    GLuint program;
+    GLuint texture;
+    GLuint vertexArray;
+
+    auto operator<=>(const Key &) const = default;
+  };
+
+  // What a draw needs besides the object that submitted it; zero when
+  // omitted.
+  struct Args {
+    GLint first;
+    GLsizei count;
+    void *resource; // e.g. the texture to bind
+  };
+
+  // Issues a command's draw; object is the submitter, e.g. its Drawable.
+  using DrawFn = void (*)(void *object, const Args &args);
+
+  static inline void submit(Key key, std::string_view name, void *object,
+                            DrawFn draw, Args args = {}) {
+    auto sequence = static_cast<uint32_t>(commands.size());
+    commands.push_back(Command{key, sequence, name, object, draw, args});
+  }
+
+  static inline void flush() {
+    // stable through the sequence, without stable_sort's buffer
+    std::sort(commands.begin(), commands.end(),
+              [](const Command &a, const Command &b) {
+                return std::tie(a.key, a.sequence) <
+                       std::tie(b.key, b.sequence);
+              });
+    for (auto &&e : commands) {
+      GpuProfiler::Scope scope{e.name, e.object};
+      e.draw(e.object, e.args);
+    }
+    commands.clear();
+  }
+
+private:
+  struct Command {
+    Key key;
+    uint32_t sequence; // of submission
+    std::string_view name;
+    void *object;
+    DrawFn draw;
+    Args args;
+  };
+
+  static inline std::vector<Command> commands{};
+};
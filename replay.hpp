@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "simulation.hpp"
+
+// Input logs of whole matches. A match is fully determined by its seed,
+// config, the aspect ratio (it places the paddles) and one InputBits byte per
+// tick, so replaying a log through Sim::Match reproduces it exactly.
+
+namespace Sim {
+
+struct Recording {
+  uint32_t seed = 1;
+  float aspect = 1;
+  Config config{};
+  std::vector<std::pair<uint32_t, float>> aspectChanges; // (tick, aspect)
+  std::vector<uint8_t> inputs;                           // one per tick
+};
+
+class Recorder {
+public:
+  Recorder(uint32_t seed, float aspect, Config config) {
+    recording.seed = seed;
+    recording.aspect = aspect;
+    recording.config = config;
+    lastAspect = aspect;
+  }
+
+  // Aspect the next tick runs with.
+  void setAspect(float aspect) {
+    if (aspect != lastAspect) {
+      recording.aspectChanges.emplace_back(recording.inputs.size(), aspect);
+      lastAspect = aspect;
+    }
+  }
+
+  void record(uint8_t input) { recording.inputs.push_back(input); }
+
+  const Recording &getRecording() const { return recording; }
+
+private:
+  Recording recording;
+  float lastAspect;
+};
+
+// Hands out a recording's inputs tick by tick. After the last tick it keeps
+// returning no input.
+class Player {
+public:
+  Player(Recording recording)
+      : recording{std::move(recording)}, aspect{this->recording.aspect} {}
+
+  uint8_t next() {
+    while (change < recording.aspectChanges.size() &&
+           recording.aspectChanges[change].first <= tick) {
+      aspect = recording.aspectChanges[change++].second;
+    }
+    if (done()) {
+      return 0;
+    }
+    return recording.inputs[tick++];
+  }
+
+  // Aspect of the tick last returned by next().
+  float getAspect() const { return aspect; }
+
+  bool done() const { return tick >= recording.inputs.size(); }
+  size_t getTick() const { return tick; }
+
+private:
+  Recording recording;
+  size_t tick = 0, change = 0;
+  float aspect;
+};
+
+// Runs a recording to its end as fast as possible.
+inline State replay(const Recording &recording) {
+  Match match{recording.aspect, recording.seed, recording.config};
+  Player player{recording};
+  while (!player.done()) {
+    auto input = player.next();
+    match.setAspect(player.getAspect());
+    match.step(unpackInput(input));
+  }
+  return match.getState();
+}
+
+// File layout, host byte order:
+//   "PGRC", version, seed, aspect, the Config fields in declaration order,
+//   tick count, aspect change count, (tick, aspect) pairs,
+//   then the inputs as (run length as LEB128, InputBits byte) runs.
+class RecordingFile {
+public:
+  static constexpr char magic[4]{'P', 'G', 'R', 'C'};
+  static constexpr uint32_t version = 1;
+
+  static bool save(const Recording &recording,
+                   const std::filesystem::path &path) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      std::cerr << "can't write recording to " << path << std::endl;
+      return false;
+    }
+    file.write(magic, sizeof(magic));
+    write(file, version);
+    write(file, recording.seed);
+    write(file, recording.aspect);
+    writeConfig(file, recording.config);
+
+    write(file, static_cast<uint32_t>(recording.inputs.size()));
+    write(file, static_cast<uint32_t>(recording.aspectChanges.size()));
+    for (auto &&[tick, aspect] : recording.aspectChanges) {
+      write(file, tick);
+      write(file, aspect);
+    }
+
+    auto &inputs = recording.inputs;
+    for (size_t i = 0; i < inputs.size();) {
+      size_t run = 1;
+      while (i + run < inputs.size() && inputs[i + run] == inputs[i]) {
+        run++;
+      }
+      for (auto n = run; true;) {
+        uint8_t byte = n & 0x7f;
+        n >>= 7;
+        file.put(static_cast<char>(n ? byte | 0x80 : byte));
+        if (!n) {
+          break;
+        }
+      }
+      file.put(static_cast<char>(inputs[i]));
+      i += run;
+    }
+    return static_cast<bool>(file);
+  }
+
+  static bool load(const std::filesystem::path &path, Recording &recording) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      std::cerr << "can't open recording " << path << std::endl;
+      return false;
+    }
+    char fileMagic[4];
+    uint32_t fileVersion = 0;
+    file.read(fileMagic, sizeof(fileMagic));
+    read(file, fileVersion);
+    if (!file || std::memcmp(fileMagic, magic, sizeof(magic)) != 0 ||
+        fileVersion != version) {
+      std::cerr << path << " is not a version " << version << " recording"
+                << std::endl;
+      return false;
+    }
+
+    Recording loaded;
+    uint32_t ticks = 0, changes = 0;
+    read(file, loaded.seed);
+    read(file, loaded.aspect);
+    readConfig(file, loaded.config);
+    read(file, ticks);
+    read(file, changes);
+    for (uint32_t i = 0; i < changes && file; i++) {
+      std::pair<uint32_t, float> change;
+      read(file, change.first);
+      read(file, change.second);
+      loaded.aspectChanges.push_back(change);
+    }
+
+    loaded.inputs.reserve(ticks);
+    while (loaded.inputs.size() < ticks && file) {
+      size_t run = 0;
+      for (int shift = 0; shift < 35; shift += 7) {
+        auto byte = static_cast<uint8_t>(file.get());
+        run |= static_cast<size_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+          break;
+        }
+      }
+      auto input = static_cast<uint8_t>(file.get());
+      if (!file || run > ticks - loaded.inputs.size()) {
+        break;
+      }
+      loaded.inputs.insert(loaded.inputs.end(), run, input);
+    }
+    if (loaded.inputs.size() != ticks) {
+      std::cerr << "recording " << path << " is truncated" << std::endl;
+      return false;
+    }
+    recording = std::move(loaded);
+    return true;
+  }
+
+private:
+  template <typename T> static void write(std::ofstream &file, const T &v) {
+    file.write(reinterpret_cast<const char *>(&v), sizeof(v));
+  }
+  template <typename T> static void read(std::ifstream &file, T &v) {
+    file.read(reinterpret_cast<char *>(&v), sizeof(v));
+  }
+
+  static void writeConfig(std::ofstream &file, const Config &c) {
+    for (auto v : {c.tickRate, c.ballSpeed, c.paddleSpeed, c.paddleWidth,
+                   c.paddleHeight, c.ballWidth, c.paddleMargin, c.attackOffset,
+                   c.spin}) {
+      write(file, v);
+    }
+    write(file, static_cast<int32_t>(c.maxBounces));
+    write(file, static_cast<int32_t>(c.matchPoint));
+  }
+
+  static void readConfig(std::ifstream &file, Config &c) {
+    for (auto *v : {&c.tickRate, &c.ballSpeed, &c.paddleSpeed, &c.paddleWidth,
+                    &c.paddleHeight, &c.ballWidth, &c.paddleMargin,
+                    &c.attackOffset, &c.spin}) {
+      read(file, *v);
+    }
+    int32_t maxBounces = 0, matchPoint = 0;
+    read(file, maxBounces);
+    read(file, matchPoint);
+    c.maxBounces = maxBounces;
+    c.matchPoint = matchPoint;
+  }
+};
+
+} // namespace Sim
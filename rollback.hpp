@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <limits>
+
+#include "simulation.hpp"
+
+// Rollback for two players on two machines. Each side steps the match every
+// tick with its own input and a prediction of the other side's; when the real
+// input arrives and differs from the prediction, the match is restored to the
+// state before that tick and simulated forward again. Both sides have to use
+// the same seed, config and aspect.
+
+namespace Sim {
+
+class Rollback {
+public:
+  // Ticks that can be rolled back. A side that gets this far ahead of the
+  // remote input it has stops advancing until the input arrives.
+  static constexpr uint32_t window = 16;
+
+  Rollback(Side side, float aspect, uint32_t seed, Config config = {})
+      : side{side}, match{aspect, seed, config} {}
+
+  // Simulates the next tick with the local input. Returns false, and does
+  // nothing, when the remote side is too far behind.
+  bool advance(uint8_t localInput) {
+    resimulate();
+    if (tick >= remoteConfirmed + window) {
+      return false;
+    }
+    at(tick).local = localInput & sideMask(side);
+    step();
+    trim();
+    return true;
+  }
+
+  // The remote side has every local input before t, so they needn't be kept
+  // for getLocalInput() anymore.
+  void acknowledge(uint32_t t) {
+    acknowledged = std::max(acknowledged, std::min(t, tick));
+    trim();
+  }
+
+  // Input of the remote side for a tick, in any order and any number of
+  // times.
+  void addRemoteInput(uint32_t remoteTick, uint8_t input) {
+    input &= sideMask(remoteSide());
+    if (remoteTick < remoteConfirmed) {
+      return;
+    }
+    auto &inputs = at(remoteTick);
+    if (inputs.known) {
+      return;
+    }
+    inputs.remote = input;
+    inputs.known = true;
+
+    if (remoteTick < tick && inputs.used != input) {
+      firstWrong = std::min(firstWrong, remoteTick);
+    }
+    for (auto *next = find(remoteConfirmed); next && next->known;
+         next = find(remoteConfirmed)) {
+      remoteConfirmed++;
+    }
+  }
+
+  // Applies the remote input that arrived since the last tick by simulating
+  // again from the first mispredicted tick. advance() does this first.
+  void resimulate() {
+    if (firstWrong == none) {
+      return;
+    }
+    auto end = tick;
+    tick = firstWrong;
+    firstWrong = none;
+    match.setState(states[tick % window]);
+    resimulated += end - tick;
+    while (tick < end) {
+      step();
+    }
+  }
+
+  const State &getState() const { return match.getState(); }
+  const Config &getConfig() const { return match.getConfig(); }
+  Side getSide() const { return side; }
+
+  // Next tick to be simulated.
+  uint32_t getTick() const { return tick; }
+  // Every remote input before this tick is known.
+  uint32_t getRemoteConfirmed() const { return remoteConfirmed; }
+  // Local input of a tick from the last one acknowledged on.
+  uint8_t getLocalInput(uint32_t t) const { return find(t)->local; }
+
+  // Ticks simulated again because of mispredictions.
+  uint64_t getResimulated() const { return resimulated; }
+
+private:
+  static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+
+  Side remoteSide() const {
+    return side == Side::left ? Side::right : Side::left;
+  }
+
+  // The remote input known for t, otherwise its last known input held;
+  // a press of space isn't repeated.
+  uint8_t remoteInput(uint32_t t) const {
+    if (auto *inputs = find(t); inputs && inputs->known) {
+      return inputs->remote;
+    }
+    if (remoteConfirmed == 0) {
+      return 0;
+    }
+    return find(remoteConfirmed - 1)->remote & ~spaceBit;
+  }
+
+  void step() {
+    states[tick % window] = match.getState();
+    auto &inputs = at(tick);
+    inputs.used = remoteInput(tick);
+    match.step(unpackInput(inputs.local | inputs.used));
+    tick++;
+  }
+
+  // Inputs of one tick.
+  struct Inputs {
+    uint8_t local = 0;
+    uint8_t used = 0; // remote input the tick was simulated with
+    uint8_t remote = 0;
+    bool known = false; // whether remote has arrived
+  };
+
+  Inputs &at(uint32_t t) {
+    if (t - first >= inputs.size()) {
+      inputs.resize(t - first + 1);
+    }
+    return inputs[t - first];
+  }
+
+  const Inputs *find(uint32_t t) const {
+    return t >= first && t - first < inputs.size() ? &inputs[t - first]
+                                                   : nullptr;
+  }
+
+  // Forgets the ticks that can't be sent, rolled back or held anymore.
+  void trim() {
+    auto keep = std::min({acknowledged, firstWrong,
+                          remoteConfirmed > 0 ? remoteConfirmed - 1 : 0});
+    while (first < keep && !inputs.empty()) {
+      inputs.pop_front();
+      first++;
+    }
+  }
+
+  Side side;
+  Match match;
+  uint32_t tick = 0;
+  uint32_t remoteConfirmed = 0;
+  uint32_t firstWrong = none;
+  uint64_t resimulated = 0;
+
+  State states[window]{}; // before each of the last `window` ticks
+  std::deque<Inputs> inputs; // from tick `first` on
+  uint32_t first = 0;
+  uint32_t acknowledged = 0;
+};
+
+} // namespace Sim
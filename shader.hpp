@@ -1,10 +1,16 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <cwchar>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <map>
 #include <memory>
 #include <ratio>
+#include <sstream>
 #include <string>
 #include <string_view>
 
@@ -12,15 +18,118 @@
 #include <GLFW/glfw3.h>
 #include <tuple>
 #include <utility>
+#include <vector>
 
+#include "embedded_shaders.hpp"
 #include "handle.hpp"
+#include "state.hpp"
 #include "traits.hpp"
 
+// Linked program binaries on disk, keyed by a hash of the driver and the
+// shader sources. A binary the driver refuses is ignored and rebuilt.
+class ProgramBinaryCache {
+public:
+  // An empty directory disables the cache.
+  static inline void setDirectory(std::filesystem::path path) {
+    directory = std::move(path);
+  }
+
+  static inline bool enabled() {
+    if (directory.empty()) {
+      return false;
+    }
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+  }
+
+  static inline uint64_t
+  key(const std::vector<std::pair<std::string_view, GLint>> &sources) {
+    uint64_t hash = 14695981039346656037ull; // FNV-1a
+    auto feed = [&](std::string_view data) {
+      for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+      }
+      hash ^= 0xff; // separator
+      hash *= 1099511628211ull;
+    };
+    for (auto name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+      auto str = reinterpret_cast<const char *>(glGetString(name));
+      feed(str ? str : "");
+    }
+    for (auto &&[source, type] : sources) {
+      feed(std::to_string(type));
+      feed(source);
+    }
+    return hash;
+  }
+
+  static inline bool load(GLuint program, uint64_t key) {
+    std::ifstream file(path(key), std::ios::binary);
+    if (!file) {
+      return false;
+    }
+    GLenum format;
+    if (!file.read(reinterpret_cast<char *>(&format), sizeof(format))) {
+      return false;
+    }
+    std::vector<char> binary{std::istreambuf_iterator<char>(file),
+                             std::istreambuf_iterator<char>()};
+    if (binary.empty()) {
+      return false;
+    }
+
+    glProgramBinary(program, format, binary.data(), binary.size());
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    return status;
+  }
+
+  static inline void store(GLuint program, uint64_t key) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+      return;
+    }
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    std::error_code err;
+    std::filesystem::create_directories(directory, err);
+    std::ofstream file(path(key), std::ios::binary | std::ios::trunc);
+    if (!file) {
+      std::cerr << "can't write program binary to " << path(key) << std::endl;
+      return;
+    }
+    file.write(reinterpret_cast<const char *>(&format), sizeof(format));
+    file.write(binary.data(), length);
+  }
+
+private:
+  static inline std::filesystem::path path(uint64_t key) {
+    std::ostringstream name;
+    name << std::hex << key << ".bin";
+    return directory / name.str();
+  }
+
+  static inline std::filesystem::path directory{};
+};
+
 class ShaderProgram : public glObject {
 private:
+  using stages_t = std::vector<std::pair<std::string, GLint>>;
+
+  static inline std::map<stages_t, std::shared_ptr<ShaderProgram>> programs{};
+
   ShaderProgramHandle handle{};
 
 public:
+  // Program linked from the given (source, shader type) pairs. Every distinct
+  // set of stages is compiled and linked once per process and then shared.
+  static std::shared_ptr<ShaderProgram> get(stages_t stages);
+
   ShaderProgram() {}
   template <typename... T> ShaderProgram(T &&...shaders) {
 
@@ -32,7 +141,7 @@ public:
 
   virtual const GLuint getHandle() { return handle; }
 
-  void use() { glUseProgram(handle); };
+  void use() { GLState::useProgram(handle); };
 };
 
 class Shader : public glObject {
@@ -40,20 +149,19 @@ class Shader : public glObject {
                          std::pair<std::shared_ptr<ShaderHandle>, bool>>
       shaders{};
 
-  static inline std::tuple<std::unique_ptr<char[]>, int>
-  readfile(std::string_view filepath) {
-    std::unique_ptr<char[]> filedata{};
+  // files read from disk by path, kept for the lifetime of the process since
+  // getSource hands out views into them
+  static inline std::map<std::filesystem::path, std::string> sources{};
+  static inline std::filesystem::path sourceDirectory{};
 
-    std::ifstream file(filepath.data());
-    file.seekg(0, std::ios::end);
-    size_t length = file.tellg();
-    filedata = std::move(std::make_unique<char[]>(length));
-
-    file.seekg(0, std::ios::beg);
-    file.read(filedata.get(), length);
-    filedata[length - 1] = '\0';
-    file.close();
-    return {std::move(filedata), length};
+  static inline std::string readfile(const std::filesystem::path &filepath) {
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file) {
+      std::cerr << "can't open shader " << filepath << std::endl;
+      return {};
+    }
+    return {std::istreambuf_iterator<char>(file),
+            std::istreambuf_iterator<char>()};
   };
 
 public:
@@ -66,12 +174,40 @@ public:
     handle = shaders[src].first;
   }
 
+  // Shaders are named by their path below shaders/, e.g.
+  // "identity/identity.vert". The sources are compiled into the binary; a
+  // development build can point this at a shaders/ tree to load them from
+  // disk instead, so edits need no rebuild. An empty path restores the
+  // embedded sources.
+  static inline void setSourceDirectory(std::filesystem::path path) {
+    sourceDirectory = std::move(path);
+  }
+
+  static inline std::string_view getSource(const std::string &src) {
+    if (sourceDirectory.empty()) {
+      for (auto &&[name, source] : EmbeddedShaders::files) {
+        if (name == src) {
+          return source;
+        }
+      }
+      std::cerr << "no embedded shader " << src << std::endl;
+      return {};
+    }
+
+    auto path = sourceDirectory / src;
+    auto it = sources.find(path);
+    if (it == sources.end()) {
+      it = sources.emplace(path, readfile(path)).first;
+    }
+    return it->second;
+  }
+
   bool compile() {
     if (!shaders[src].second) {
-      auto &&[file, size] = readfile(src);
-      auto p = file.get();
-      auto pp = &p;
-      glShaderSource(*handle, 1, pp, &size);
+      auto source = getSource(src);
+      auto p = source.data();
+      GLint size = source.size();
+      glShaderSource(*handle, 1, &p, &size);
       glCompileShader(*handle);
       shaders[src].second = true;
     }
@@ -100,3 +236,47 @@ private:
   std::string src;
   bool compileSatus = false;
 };
+
+inline std::shared_ptr<ShaderProgram> ShaderProgram::get(stages_t stages) {
+  std::sort(stages.begin(), stages.end());
+  if (programs.count(stages)) {
+    return programs.at(stages);
+  }
+
+  auto program = std::make_shared<ShaderProgram>();
+  programs[stages] = program;
+
+  bool useBinaryCache = ProgramBinaryCache::enabled();
+  uint64_t binaryKey = 0;
+  if (useBinaryCache) {
+    std::vector<std::pair<std::string_view, GLint>> sources;
+    for (auto &&[src, type] : stages) {
+      sources.emplace_back(Shader::getSource(src), type);
+    }
+    binaryKey = ProgramBinaryCache::key(sources);
+    if (ProgramBinaryCache::load(*program, binaryKey)) {
+      return program;
+    }
+    glProgramParameteri(*program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+
+  std::vector<Shader> shaders;
+  shaders.reserve(stages.size());
+  for (auto &&[src, type] : stages) {
+    shaders.emplace_back(src, type).compile();
+  }
+  for (auto &&e : shaders) {
+    glAttachShader(*program, e);
+  }
+  glLinkProgram(*program);
+  for (auto &&e : shaders) {
+    glDetachShader(*program, e);
+  }
+
+  GLint status;
+  glGetProgramiv(*program, GL_LINK_STATUS, &status);
+  if (useBinaryCache && status) {
+    ProgramBinaryCache::store(*program, binaryKey);
+  }
+  return program;
+}
@@ -1,13 +1,13 @@
 #version 460 core
 
 in vec2 uv;
-layout(location=4)uniform vec3 textColor;
+in vec3 fragColor;
 
 out vec4 color;
 
-uniform sampler2D text;
+layout(binding=0)uniform sampler2D text;
 
 void main(){
-   color=vec4(textColor,1)*texture(text,uv).r;
+   color=vec4(fragColor,1)*texture(text,uv).r;
 }
 
@@ -1,15 +1,25 @@
 #version 460 core
 
-layout(location=0)in vec3 position;
-layout(location=1)in vec2 imageUV;
+layout(location=0)in vec2 offset;
+layout(location=1)in vec2 size;
+layout(location=2)in vec4 uvRect;
+layout(location=3)in vec3 textColor;
 
-layout(location=2)uniform float aspect;
-layout(location=3)uniform sampler2D text;
-layout(location=4)uniform vec3 textColor;
+layout(std140,binding=0)uniform FrameGlobals{
+   mat4 projection;
+   vec2 viewport;
+   float aspect;
+   float time;
+};
 
 out vec2 uv;
+out vec3 fragColor;
 
 void main(){
-   gl_Position=vec4(1/aspect,1,1,1)*vec4(position,1);
-   uv=imageUV;
+   // triangle strip corners: (0,0) (1,0) (0,1) (1,1)
+   vec2 corner=vec2(gl_VertexID&1,gl_VertexID>>1);
+   vec2 position=offset+corner*size;
+   gl_Position=projection*vec4(position,0,1);
+   uv=vec2(mix(uvRect.x,uvRect.z,corner.x),mix(uvRect.w,uvRect.y,corner.y));
+   fragColor=textColor;
 }
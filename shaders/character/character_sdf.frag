@@ -0,0 +1,16 @@
+#version 460 core
+
+in vec2 uv;
+in vec3 fragColor;
+
+out vec4 color;
+
+layout(binding=0)uniform sampler2D text;
+
+// The glyph is a distance field with its outline at 0.5; blending across
+// fwidth keeps the edge one pixel wide at any scale.
+void main(){
+   float distance=texture(text,uv).r;
+   float edge=fwidth(distance);
+   color=vec4(fragColor,1)*smoothstep(0.5-edge,0.5+edge,distance);
+}
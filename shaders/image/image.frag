@@ -0,0 +1,11 @@
+#version 460 core
+
+in vec2 uv;
+
+out vec4 color;
+
+layout(binding=0)uniform sampler2D image;
+
+void main(){
+   color=texture(image,uv);
+}
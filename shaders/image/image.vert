@@ -0,0 +1,18 @@
+#version 460 core
+
+layout(location=0)in vec3 position;
+layout(location=1)in vec2 texCoord;
+
+layout(std140,binding=0)uniform FrameGlobals{
+   mat4 projection;
+   vec2 viewport;
+   float aspect;
+   float time;
+};
+
+out vec2 uv;
+
+void main(){
+   gl_Position=projection*vec4(position,1);
+   uv=texCoord;
+}
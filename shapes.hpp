@@ -1,47 +1,181 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <memory>
 #include <vector>
 
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
 #include <glm/glm.hpp>
 
+#include "buffer.hpp"
 #include "polygon.hpp"
+#include "render.hpp"
+#include "shader.hpp"
+#include "traits.hpp"
 
 namespace Shapes {
-class Rectangle : public Animatable<glm::vec2, float, float>, public Drawable {
+// Collects every rectangle drawn in a frame into one vertex stream and draws
+// them with a single call. Rectangles only submit themselves in draw();
+// nothing is submitted to the RenderQueue until flush(), and a frame that
+// draws the same unchanged quads as the last one reuses the vertices already
+// uploaded.
+class QuadBatch {
 public:
-  Rectangle(auto &&pos, float width, float height, auto &&color) {
-    std::vector<glm::vec3> tmpcolors(4);
-    for (auto &e : tmpcolors) {
-      e = color;
+  struct Quad {
+    glm::vec2 pos;
+    glm::vec2 size;
+    glm::vec3 color;
+  };
+
+  static inline size_t add(const Quad &quad) {
+    if (freeSlots.empty()) {
+      quads.push_back(quad);
+      dirty = true;
+      return quads.size() - 1;
     }
-    colors = tmpcolors;
-    update({pos.x, pos.y}, width, height);
+    auto slot = freeSlots.back();
+    freeSlots.pop_back();
+    quads[slot] = quad;
+    dirty = true;
+    return slot;
   }
 
-  virtual void update(glm::vec2 pos, float width, float height) override {
-    this->x = pos.x;
-    this->y = pos.y;
-    this->width = width;
-    this->height = height;
+  static inline void remove(size_t slot) {
+    freeSlots.push_back(slot);
+    dirty = true;
+  }
+
+  static inline const Quad &get(size_t slot) { return quads[slot]; }
+
+  static inline void set(size_t slot, glm::vec2 pos, glm::vec2 size) {
+    auto &quad = quads[slot];
+    if (quad.pos != pos || quad.size != size) {
+      quad.pos = pos;
+      quad.size = size;
+      dirty = true;
+    }
+  }
+
+  static inline void submit(size_t slot) { submitted.push_back(slot); }
+
+  static inline void flush() {
+    if (submitted.empty()) {
+      return;
+    }
+    if (dirty || submitted != drawn) {
+      upload();
+    }
+    submitted.swap(drawn);
+    submitted.clear();
+
+    // one draw for every quad, so it is timed as a whole, not per Rectangle
+    RenderQueue::submit(
+        {RenderQueue::world, *shader, 0, array->getHandle()}, "QuadBatch",
+        nullptr,
+        [](void *, const RenderQueue::Args &args) {
+          array->bind();
+          shader->use();
+          glDrawArrays(GL_TRIANGLES, args.first, args.count);
+          vertexBuffer->fence();
+        },
+        {static_cast<GLint>(vertexBuffer->getFirst()),
+         static_cast<GLsizei>(vertices.size())});
+  }
+
+private:
+  struct Vertex {
+    glm::vec3 position;
+    glm::vec3 color;
+  };
+
+  static inline void upload() {
+    vertices.clear();
+    for (auto slot : submitted) {
+      auto &q = quads[slot];
+      auto x0 = q.pos.x - (q.size.x / 2), x1 = q.pos.x + (q.size.x / 2);
+      auto y0 = q.pos.y - (q.size.y / 2), y1 = q.pos.y + (q.size.y / 2);
+      glm::vec2 corners[]{{x0, y1}, {x0, y0}, {x1, y1},
+                          {x1, y1}, {x0, y0}, {x1, y0}};
+      for (auto &&c : corners) {
+        vertices.push_back(Vertex{glm::vec3{c.x, c.y, 0}, q.color});
+      }
+    }
+
+    if (!vertexBuffer || vertexBuffer->getSize() < vertices.size()) {
+      reserve(std::max<size_t>(vertices.size() * 2, 6 * 64));
+    }
+    vertexBuffer->write(vertices);
+    dirty = false;
+  }
+
+  static inline void reserve(size_t capacity) {
+    if (!array) {
+      array = std::make_unique<VertexArray>();
+      shader = ShaderProgram::get(
+          {{Polygon::vertexShaderPath, GL_VERTEX_SHADER},
+           {Polygon::fragmentshaderPath, GL_FRAGMENT_SHADER}});
+    }
+    vertexBuffer = std::make_unique<StreamBuffer<Vertex>>(capacity);
+
+    array->vertexArrayVertexBuffer(0, vertexBuffer->getHandle(), 0,
+                                   sizeof(Vertex));
+
+    array->enableVertexArrayAttrib(0);
+    array->enableVertexArrayAttrib(1);
+
+    array->vertexArrayAttribFormat(0, 3, GL_FLOAT, GL_FALSE,
+                                   offsetof(Vertex, position));
+    array->vertexArrayAttribFormat(1, 3, GL_FLOAT, GL_FALSE,
+                                   offsetof(Vertex, color));
+
+    array->vertexArrayAttribBinding(0, 0);
+    array->vertexArrayAttribBinding(1, 0);
+  }
+
+  static inline std::vector<Quad> quads{};
+  static inline std::vector<size_t> freeSlots{};
+  static inline std::vector<size_t> submitted{};
+  static inline std::vector<size_t> drawn{}; // slots of the last flush
+  static inline bool dirty = true;
+  static inline std::vector<Vertex> vertices{};
 
-    glm::vec3 vertices[]{
-        {x - (width / 2), y + (height / 2), 0},
-        {x - (width / 2), y - (height / 2), 0},
-        {x + (width / 2), y + (height / 2), 0},
-        {x + (width / 2), y - (height / 2), 0},
-    };
+  static inline std::unique_ptr<VertexArray> array{nullptr};
+  static inline std::unique_ptr<StreamBuffer<Vertex>> vertexBuffer{nullptr};
+  static inline std::shared_ptr<ShaderProgram> shader{nullptr};
+};
+
+// Handle to a quad of QuadBatch.
+class Rectangle : public Animatable<glm::vec2, float, float>, public Drawable {
+public:
+  Rectangle(auto &&pos, float width, float height, auto &&color)
+      : slot{QuadBatch::add(QuadBatch::Quad{glm::vec2{pos.x, pos.y},
+                                            glm::vec2{width, height}, color})} {
+  }
 
-    ply.update(vertices, colors);
+  Rectangle(const Rectangle &) = delete;
+  Rectangle &operator=(const Rectangle &) = delete;
+
+  ~Rectangle() { QuadBatch::remove(slot); }
+
+  virtual void update(glm::vec2 pos, float width, float height) override {
+    QuadBatch::set(slot, pos, glm::vec2{width, height});
   }
 
-  virtual void draw() override { ply.draw(); }
+  virtual void draw() override { QuadBatch::submit(slot); }
 
-  std::tuple<float, float> getPos() { return {x, y}; }
-  std::tuple<float, float> getSize() { return {width, height}; }
+  std::tuple<float, float> getPos() {
+    auto &quad = QuadBatch::get(slot);
+    return {quad.pos.x, quad.pos.y};
+  }
+  std::tuple<float, float> getSize() {
+    auto &quad = QuadBatch::get(slot);
+    return {quad.size.x, quad.size.y};
+  }
 
 private:
-  Shapes::Polygon ply{4, 4};
-  std::vector<glm::vec3> colors;
-  float x, y, width, height;
+  size_t slot;
 };
 } // namespace Shapes
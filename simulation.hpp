@@ -0,0 +1,391 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// Pong rules without any GL, FreeType or platform dependency.
+// Pong mirrors Sim::State into its drawables; everything else (bots, tests,
+// server side validation) can step a Sim::Match directly.
+
+namespace Sim {
+
+enum class GameState : uint8_t {
+  beginGame,
+  gamePlaying,
+  attackPlayer,
+  goal,
+  over
+};
+
+struct Input {
+  bool rUp = false;
+  bool rDown = false;
+  bool lUp = false;
+  bool lDown = false;
+  bool space = false;
+};
+
+// One byte per tick and player pair, used wherever inputs are stored in bulk.
+enum InputBits : uint8_t {
+  rUpBit = 1 << 0,
+  rDownBit = 1 << 1,
+  lUpBit = 1 << 2,
+  lDownBit = 1 << 3,
+  spaceBit = 1 << 4
+};
+
+inline uint8_t packInput(const Input &input) {
+  return (input.rUp ? rUpBit : 0) | (input.rDown ? rDownBit : 0) |
+         (input.lUp ? lUpBit : 0) | (input.lDown ? lDownBit : 0) |
+         (input.space ? spaceBit : 0);
+}
+
+inline Input unpackInput(uint8_t bits) {
+  return Input{(bits & rUpBit) != 0, (bits & rDownBit) != 0,
+               (bits & lUpBit) != 0, (bits & lDownBit) != 0,
+               (bits & spaceBit) != 0};
+}
+
+enum class Side : uint8_t { left, right };
+
+// The InputBits a side controls. Either side may serve.
+inline uint8_t sideMask(Side side) {
+  return side == Side::left ? lUpBit | lDownBit | spaceBit
+                            : rUpBit | rDownBit | spaceBit;
+}
+
+// Speeds are in units per second; a tick advances the match by 1 / tickRate
+// seconds regardless of how often frames are drawn.
+struct Config {
+  float tickRate = 120;
+
+  float ballSpeed = 1.2;
+  float paddleSpeed = 0.9;
+  float paddleWidth = 0.1;
+  float paddleHeight = 0.3;
+  float ballWidth = 0.15;
+
+  float paddleMargin = 0.9; // paddles sit at +-paddleMargin * aspect
+  float attackOffset = 0.15;
+  float spin = 0.3; // random y speed added when hit by a moving paddle
+  int maxBounces = 4; // ball impacts resolved per tick
+
+  int matchPoint = 12;
+
+  float getTickDuration() const { return 1.0f / tickRate; }
+
+  static bool validTickRate(float rate) {
+    return std::isfinite(rate) && rate > 0;
+  }
+
+  // Whether a match can run with this config; check configs read from files.
+  bool valid() const {
+    for (auto v : {ballSpeed, paddleSpeed, paddleWidth, paddleHeight,
+                   ballWidth, paddleMargin, attackOffset, spin}) {
+      if (!std::isfinite(v)) {
+        return false;
+      }
+    }
+    return validTickRate(tickRate) && maxBounces >= 0 && matchPoint > 0;
+  }
+};
+
+struct PaddleState {
+  float x, y;
+  bool moving;
+};
+
+struct BallState {
+  float x, y;
+  float speedX, speedY;
+};
+
+struct State {
+  GameState gameState;
+  BallState ball;
+  PaddleState rPaddle, lPaddle;
+  int rScore, lScore;
+  uint32_t rng;
+};
+
+// xorshift32, so a match is reproducible from its seed.
+inline uint32_t nextRandom(uint32_t &rng) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+inline float getRandomf(uint32_t &rng, float min, float max) {
+  return min + (max - min) * (static_cast<float>(nextRandom(rng) >> 8) /
+                              static_cast<float>(1 << 24));
+}
+
+class Match {
+public:
+  Match(float aspect, uint32_t seed = 1, Config config = {})
+      : config{config}, aspect{aspect} {
+    reset(seed);
+  }
+
+  void reset(uint32_t seed) {
+    state = State{};
+    state.gameState = GameState::beginGame;
+    state.rng = seed != 0 ? seed : 1;
+    state.rPaddle = {config.paddleMargin * aspect, 0, false};
+    state.lPaddle = {-config.paddleMargin * aspect, 0, false};
+    state.ball = {0, 0, config.ballSpeed, 0};
+  }
+
+  void step(const Input &input) {
+    using enum GameState;
+    switch (state.gameState) {
+    case beginGame:
+      begin(input);
+      break;
+    case gamePlaying:
+      playing(input);
+      break;
+    case attackPlayer:
+      playerAttack(input);
+      break;
+    case goal:
+      ballGoaled(input);
+      break;
+    case over:
+      gameOver(input);
+    }
+  }
+
+  void setAspect(float newAspect) { aspect = newAspect; }
+
+  const State &getState() const { return state; }
+  // Restores a state taken from getState(), e.g. to roll back.
+  void setState(const State &newState) { state = newState; }
+  const Config &getConfig() const { return config; }
+
+private:
+  void playing(const Input &input) {
+    sweepBall();
+    movePaddles(input);
+
+    if (state.rPaddle.x < state.ball.x || state.ball.x < state.lPaddle.x) {
+      state.gameState = GameState::goal;
+    }
+  }
+
+  void begin(const Input &input) {
+    movePaddles(input);
+    if (input.space) {
+      float v = getRandomf(state.rng, 0, 2);
+      float speedX = v > 1.0f ? config.ballSpeed : -config.ballSpeed;
+      state.ball = {0, 0, speedX, 0};
+      sweepBall();
+      state.gameState = GameState::gamePlaying;
+    }
+  }
+
+  void gameOver(const Input &input) {
+    state.ball.x = 0;
+    state.ball.y = 0;
+
+    if (input.space) {
+      state.gameState = GameState::beginGame;
+      state.rScore = 0;
+      state.lScore = 0;
+    }
+  }
+
+  void playerAttack(const Input &input) {
+    movePaddles(input);
+    auto &ball = state.ball;
+    if (ball.x < 0.0f) { // goaled to left side
+      ball.x = state.lPaddle.x + config.attackOffset;
+      ball.y = state.lPaddle.y;
+      if (input.space) {
+        ball.speedX = config.ballSpeed;
+        ball.speedY = 0;
+        state.gameState = GameState::gamePlaying;
+      }
+    } else if (0.0f < ball.x) { // goaled to right side
+      ball.x = state.rPaddle.x - config.attackOffset;
+      ball.y = state.rPaddle.y;
+      if (input.space) {
+        ball.speedX = -config.ballSpeed;
+        ball.speedY = 0;
+        state.gameState = GameState::gamePlaying;
+      }
+    }
+  }
+
+  void ballGoaled(const Input &input) {
+    movePaddles(input);
+    if (state.ball.x < 0.0f) { // goaled to left side
+      state.rScore += 1;
+    } else if (0.0f < state.ball.x) { // goaled to right side
+      state.lScore += 1;
+    }
+    if (state.lScore < config.matchPoint && state.rScore < config.matchPoint) {
+      state.gameState = GameState::attackPlayer;
+    } else {
+      state.gameState = GameState::over;
+    }
+  }
+
+  void movePaddles(const Input &input) {
+    movePaddle(state.rPaddle, input.rUp, input.rDown);
+    movePaddle(state.lPaddle, input.lUp, input.lDown);
+
+    state.rPaddle.x = config.paddleMargin * aspect;
+    state.lPaddle.x = -config.paddleMargin * aspect;
+  }
+
+  void movePaddle(PaddleState &paddle, bool up, bool down) {
+    auto halfHeight = config.paddleHeight / 2;
+    auto step = config.paddleSpeed * config.getTickDuration();
+    if (up && paddle.y < 1 - halfHeight) {
+      paddle.y += step;
+      paddle.moving = true;
+    } else if (down && paddle.y > -1 + halfHeight) {
+      paddle.y -= step;
+      paddle.moving = true;
+    } else {
+      paddle.moving = false;
+    }
+  }
+
+  struct Impact {
+    float time;
+    bool wall;
+    const PaddleState *paddle;
+    bool xFace;
+  };
+
+  // Moves the ball through one tick. Walls and paddles are hit at their exact
+  // time of impact, so a fast ball can't tunnel through a paddle and may
+  // bounce several times within the tick.
+  void sweepBall() {
+    auto &ball = state.ball;
+    float left = config.getTickDuration();
+    for (int i = 0; i < config.maxBounces; i++) {
+      auto impact = findImpact(left);
+
+      ball.x += ball.speedX * impact.time;
+      ball.y += ball.speedY * impact.time;
+      left -= impact.time;
+
+      if (impact.paddle) {
+        if (impact.paddle->moving) {
+          ball.speedY += getRandomf(state.rng, -config.spin, config.spin);
+        }
+        if (impact.xFace) {
+          ball.speedX *= -1;
+        } else {
+          ball.speedY *= -1;
+        }
+      } else if (impact.wall) {
+        ball.speedY *= -1;
+      }
+    }
+  }
+
+  // Earliest impact within the next `left` seconds. An impact exactly at the
+  // end of the window is left for the next tick.
+  Impact findImpact(float left) const {
+    auto &ball = state.ball;
+    auto halfWidth = config.ballWidth / 2;
+    Impact impact{left, false, nullptr, false};
+
+    if (ball.speedY > 0.0f) {
+      auto time = std::max((1 - halfWidth - ball.y) / ball.speedY, 0.0f);
+      if (time <= left && time < impact.time) {
+        impact = {time, true, nullptr, false};
+      }
+    }
+    if (ball.speedY < 0.0f) {
+      auto time = std::max((-1 + halfWidth - ball.y) / ball.speedY, 0.0f);
+      if (time <= left && time < impact.time) {
+        impact = {time, true, nullptr, false};
+      }
+    }
+
+    for (auto *paddle : {&state.lPaddle, &state.rPaddle}) {
+      float time;
+      bool xFace;
+      if (sweepPaddle(*paddle, left, time, xFace) && time < impact.time) {
+        impact = {time, false, paddle, xFace};
+      }
+    }
+    return impact;
+  }
+
+  // Swept AABB test of the ball against the face of a paddle turned to the
+  // field: the paddle is grown by the ball's half size and the ball's center
+  // is traced against the slabs of that box.
+  bool sweepPaddle(const PaddleState &paddle, float left, float &time,
+                   bool &xFace) const {
+    auto &ball = state.ball;
+    auto halfWidth = config.ballWidth / 2;
+    auto x0 = paddle.x - config.paddleWidth / 2 - halfWidth;
+    auto x1 = paddle.x + config.paddleWidth / 2 + halfWidth;
+    auto y0 = paddle.y - config.paddleHeight / 2 - halfWidth;
+    auto y1 = paddle.y + config.paddleHeight / 2 + halfWidth;
+
+    bool isLeft = paddle.x < 0.0f;
+    if (isLeft ? !(ball.speedX < 0.0f) : !(ball.speedX > 0.0f)) {
+      return false;
+    }
+    auto xEntry = ((isLeft ? x1 : x0) - ball.x) / ball.speedX;
+    auto xExit = ((isLeft ? x0 : x1) - ball.x) / ball.speedX;
+
+    float yEntry, yExit;
+    if (ball.speedY > 0.0f) {
+      yEntry = (y0 - ball.y) / ball.speedY;
+      yExit = (y1 - ball.y) / ball.speedY;
+    } else if (ball.speedY < 0.0f) {
+      yEntry = (y1 - ball.y) / ball.speedY;
+      yExit = (y0 - ball.y) / ball.speedY;
+    } else if (y0 < ball.y && ball.y < y1) {
+      yEntry = -std::numeric_limits<float>::infinity();
+      yExit = std::numeric_limits<float>::infinity();
+    } else {
+      return false;
+    }
+
+    auto entry = std::max(xEntry, yEntry);
+    auto exit = std::min(xExit, yExit);
+    if (!(entry < exit && exit > 0.0f && entry <= left)) {
+      return false;
+    }
+    time = std::max(entry, 0.0f);
+    xFace = xEntry >= yEntry;
+    return true;
+  }
+
+  Config config;
+  float aspect;
+  State state;
+};
+
+// Blends two consecutive ticks for drawing. Positions are only blended while
+// the match stays in the same game state, so resets and serves don't smear.
+inline State interpolate(const State &previous, const State &current,
+                         float alpha) {
+  if (previous.gameState != current.gameState) {
+    return current;
+  }
+  auto mix = [alpha](float a, float b) { return a + (b - a) * alpha; };
+
+  State state = current;
+  state.ball.x = mix(previous.ball.x, current.ball.x);
+  state.ball.y = mix(previous.ball.y, current.ball.y);
+  state.rPaddle.x = mix(previous.rPaddle.x, current.rPaddle.x);
+  state.rPaddle.y = mix(previous.rPaddle.y, current.rPaddle.y);
+  state.lPaddle.x = mix(previous.lPaddle.x, current.lPaddle.x);
+  state.lPaddle.y = mix(previous.lPaddle.y, current.lPaddle.y);
+  return state;
+}
+
+} // namespace Sim
@@ -0,0 +1,377 @@
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "net.hpp"
+#include "simulation.hpp"
+
+// Streams a match from the process that simulates it to any number of
+// viewers over TCP. Each tick is encoded once and the same buffer is queued to
+// every viewer; a viewer that can't keep up loses its backlog and picks the
+// stream up again at the next keyframe, so it never holds back the game.
+//
+// Stream: frames of u16 size (little endian) followed by size bytes of
+// bits, least significant first:
+//   keyframe bit; for a keyframe the tick (32 bits), the game state (3 bits)
+//   and every field as 32 bits; otherwise, for the tick after the previous
+//   frame, a changed bit for the game state (then its 3 bits) and one per
+//   field, followed by the zigzagged difference as (bit length - 1 in 5 bits,
+//   bits).
+// Fields are the positions in 1/8192 units and the scores, in Snapshot order.
+
+namespace Spectate {
+
+// What viewers need of a State.
+struct Snapshot {
+  static constexpr int fieldCount = 8;
+  static constexpr float scale = 8192;
+
+  Sim::GameState gameState{};
+  int32_t fields[fieldCount]{}; // ball, right paddle, left paddle, scores
+
+  static Snapshot from(const Sim::State &state) {
+    auto q = [](float v) {
+      return static_cast<int32_t>(std::lround(v * scale));
+    };
+    return {state.gameState,
+            {q(state.ball.x), q(state.ball.y), q(state.rPaddle.x),
+             q(state.rPaddle.y), q(state.lPaddle.x), q(state.lPaddle.y),
+             state.rScore, state.lScore}};
+  }
+
+  Sim::State toState() const {
+    Sim::State state{};
+    state.gameState = gameState;
+    state.ball.x = fields[0] / scale;
+    state.ball.y = fields[1] / scale;
+    state.rPaddle.x = fields[2] / scale;
+    state.rPaddle.y = fields[3] / scale;
+    state.lPaddle.x = fields[4] / scale;
+    state.lPaddle.y = fields[5] / scale;
+    state.rScore = fields[6];
+    state.lScore = fields[7];
+    return state;
+  }
+};
+
+class BitWriter {
+public:
+  void write(uint32_t value, int bits) {
+    for (int i = 0; i < bits; i++, count++) {
+      if (count % 8 == 0) {
+        bytes.push_back(0);
+      }
+      bytes.back() |= ((value >> i) & 1) << (count % 8);
+    }
+  }
+
+  std::vector<uint8_t> bytes;
+
+private:
+  size_t count = 0;
+};
+
+class BitReader {
+public:
+  BitReader(std::span<const uint8_t> bytes) : bytes{bytes} {}
+
+  uint32_t read(int bits) {
+    uint32_t value = 0;
+    for (int i = 0; i < bits; i++, count++) {
+      if (count / 8 >= bytes.size()) {
+        overrun = true;
+        return 0;
+      }
+      value |= static_cast<uint32_t>(bytes[count / 8] >> (count % 8) & 1) << i;
+    }
+    return value;
+  }
+
+  bool overrun = false;
+
+private:
+  std::span<const uint8_t> bytes;
+  size_t count = 0;
+};
+
+using Frame = std::shared_ptr<const std::vector<uint8_t>>;
+
+class Encoder {
+public:
+  // Every this many ticks the whole snapshot is sent.
+  static constexpr uint32_t keyframeInterval = 120;
+
+  // The frame for the next tick. Keyframes start at tick 0.
+  Frame encode(const Sim::State &state) {
+    auto snapshot = Snapshot::from(state);
+    bool keyframe = tick % keyframeInterval == 0;
+
+    BitWriter bits;
+    bits.write(keyframe, 1);
+    if (keyframe) {
+      bits.write(tick, 32);
+      bits.write(static_cast<uint32_t>(snapshot.gameState), 3);
+      for (auto field : snapshot.fields) {
+        bits.write(static_cast<uint32_t>(field), 32);
+      }
+    } else {
+      bool changed = snapshot.gameState != previous.gameState;
+      bits.write(changed, 1);
+      if (changed) {
+        bits.write(static_cast<uint32_t>(snapshot.gameState), 3);
+      }
+      for (int i = 0; i < Snapshot::fieldCount; i++) {
+        auto delta = static_cast<uint32_t>(snapshot.fields[i]) -
+                     static_cast<uint32_t>(previous.fields[i]);
+        bits.write(delta != 0, 1);
+        if (delta != 0) {
+          auto zigzag = delta << 1 ^ -(delta >> 31);
+          int length = 32 - std::countl_zero(zigzag);
+          bits.write(length - 1, 5);
+          bits.write(zigzag, length);
+        }
+      }
+    }
+
+    auto frame = std::make_shared<std::vector<uint8_t>>();
+    frame->reserve(2 + bits.bytes.size());
+    frame->push_back(static_cast<uint8_t>(bits.bytes.size()));
+    frame->push_back(static_cast<uint8_t>(bits.bytes.size() >> 8));
+    frame->insert(frame->end(), bits.bytes.begin(), bits.bytes.end());
+
+    previous = snapshot;
+    tick++;
+    return frame;
+  }
+
+  static bool isKeyframe(const Frame &frame) {
+    return frame->size() > 2 && ((*frame)[2] & 1);
+  }
+
+private:
+  Snapshot previous;
+  uint32_t tick = 0;
+};
+
+// Reassembles frames from the received bytes and applies them. Deltas before
+// the first keyframe, or after a keyframe was missed, are skipped. A frame
+// that is cut short or holds no valid game state is dropped like a missed
+// keyframe.
+class Decoder {
+public:
+  void receive(std::span<const uint8_t> data) {
+    pending.insert(pending.end(), data.begin(), data.end());
+
+    size_t at = 0;
+    while (pending.size() - at >= 2) {
+      size_t size = pending[at] | pending[at + 1] << 8;
+      if (pending.size() - at - 2 < size) {
+        break;
+      }
+      apply({pending.data() + at + 2, size});
+      at += 2 + size;
+    }
+    pending.erase(pending.begin(), pending.begin() + at);
+  }
+
+  // Snapshots decoded and not yet taken, oldest first.
+  std::deque<Snapshot> snapshots;
+
+  uint32_t getTick() const { return tick; }
+
+private:
+  void apply(std::span<const uint8_t> payload) {
+    BitReader bits{payload};
+    Snapshot snapshot = current;
+    bool valid = true;
+    if (bits.read(1)) {
+      tick = bits.read(32);
+      valid = readGameState(bits, snapshot.gameState);
+      for (auto &field : snapshot.fields) {
+        field = static_cast<int32_t>(bits.read(32));
+      }
+      synced = true;
+    } else {
+      if (!synced) {
+        return;
+      }
+      tick++;
+      if (bits.read(1)) {
+        valid = readGameState(bits, snapshot.gameState);
+      }
+      for (auto &field : snapshot.fields) {
+        if (bits.read(1)) {
+          auto zigzag = bits.read(bits.read(5) + 1);
+          auto delta = zigzag >> 1 ^ -(zigzag & 1);
+          field = static_cast<int32_t>(static_cast<uint32_t>(field) + delta);
+        }
+      }
+    }
+    if (bits.overrun || !valid) {
+      synced = false;
+      return;
+    }
+    current = snapshot;
+    snapshots.push_back(snapshot);
+  }
+
+  // False for the values past GameState::over that 3 bits can hold.
+  static bool readGameState(BitReader &bits, Sim::GameState &gameState) {
+    auto value = bits.read(3);
+    if (value > static_cast<uint32_t>(Sim::GameState::over)) {
+      return false;
+    }
+    gameState = static_cast<Sim::GameState>(value);
+    return true;
+  }
+
+  std::vector<uint8_t> pending;
+  Snapshot current;
+  uint32_t tick = 0;
+  bool synced = false;
+};
+
+// Accepts viewers and sends every tick to all of them without blocking.
+class Server {
+public:
+  // Bytes a viewer may fall behind by before its backlog is dropped.
+  static constexpr size_t maxQueued = 16 * 1024;
+
+  bool listen(uint16_t port) { return listener.listen(port); }
+
+  // Call once per tick with the new state.
+  void broadcast(const Sim::State &state) {
+    for (auto socket = listener.accept(); socket.valid();
+         socket = listener.accept()) {
+      viewers.push_back(Viewer{std::move(socket)});
+    }
+
+    auto frame = encoder.encode(state);
+    bool keyframe = Encoder::isKeyframe(frame);
+    for (auto &viewer : viewers) {
+      if (!viewer.queue(frame, keyframe)) {
+        resyncs++;
+      }
+    }
+    std::erase_if(viewers, [](Viewer &viewer) { return !viewer.flush(); });
+  }
+
+  size_t getViewerCount() const { return viewers.size(); }
+  // Backlogs dropped because a viewer was too slow.
+  uint64_t getResyncs() const { return resyncs; }
+
+private:
+  struct Viewer {
+    Viewer(Net::TcpSocket socket) : socket{std::move(socket)} {}
+
+    Net::TcpSocket socket;
+    std::deque<Frame> frames;
+    size_t sent = 0; // of the first frame
+    size_t queued = 0;
+    bool waiting = true; // for a keyframe
+
+    // False when the backlog had to be dropped first.
+    bool queue(const Frame &frame, bool keyframe) {
+      bool kept = true;
+      if (queued + frame->size() > maxQueued) {
+        // the partly sent frame has to go out whole to keep the framing
+        auto partial = sent ? frames.front() : nullptr;
+        frames.clear();
+        queued = 0;
+        if (partial) {
+          frames.push_back(partial);
+          queued = partial->size() - sent;
+        }
+        waiting = true;
+        kept = false;
+      }
+      if (waiting && !keyframe) {
+        return kept;
+      }
+      waiting = false;
+      frames.push_back(frame);
+      queued += frame->size();
+      return kept;
+    }
+
+    // False once the viewer has gone.
+    bool flush() {
+      while (!frames.empty()) {
+        auto &frame = *frames.front();
+        auto n = socket.send(std::span{frame}.subspan(sent));
+        if (n < 0) {
+          return false;
+        }
+        if (n == 0) {
+          return true;
+        }
+        sent += n;
+        queued -= n;
+        if (sent == frame.size()) {
+          frames.pop_front();
+          sent = 0;
+        }
+      }
+      return true;
+    }
+  };
+
+  Net::TcpListener listener;
+  Encoder encoder;
+  std::vector<Viewer> viewers;
+  uint64_t resyncs = 0;
+};
+
+// Watches a Server's match, one tick behind it.
+class Client {
+public:
+  // Ticks received ahead of the one shown before skipping to the latest.
+  static constexpr size_t maxBehind = 4;
+
+  bool connect(const std::string &host, uint16_t port) {
+    return socket.connect(host, port);
+  }
+
+  // Takes the next tick from the stream. Returns false, keeping the last
+  // one, when it hasn't arrived yet.
+  bool update() {
+    uint8_t buffer[4096];
+    long n;
+    while ((n = socket.receive(buffer)) > 0) {
+      decoder.receive(std::span{buffer, static_cast<size_t>(n)});
+    }
+    if (n < 0) {
+      connected = false;
+    }
+
+    auto &snapshots = decoder.snapshots;
+    if (snapshots.empty()) {
+      return false;
+    }
+    if (snapshots.size() > maxBehind) {
+      snapshots.erase(snapshots.begin(), snapshots.end() - 1);
+    }
+    state = snapshots.front().toState();
+    snapshots.pop_front();
+    return true;
+  }
+
+  const Sim::State &getState() const { return state; }
+  bool isConnected() const { return connected; }
+
+private:
+  Net::TcpSocket socket;
+  Decoder decoder;
+  Sim::State state{};
+  bool connected = true;
+};
+
+} // namespace Spectate
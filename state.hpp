@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+// Mirror of the GL bindings made through the wrappers. Binding what is
+// already bound returns without calling GL. Everything that binds programs,
+// vertex arrays or textures must go through here, and deleted objects must
+// be forgotten, or the mirror goes stale.
+class GLState {
+public:
+  static constexpr GLuint textureUnits = 16;
+
+  static inline void useProgram(GLuint program) {
+    if (change(currentProgram, program)) {
+      glUseProgram(program);
+    }
+  }
+
+  static inline void bindVertexArray(GLuint array) {
+    if (change(currentVertexArray, array)) {
+      glBindVertexArray(array);
+    }
+  }
+
+  // Binds to the active texture unit.
+  static inline void bindTexture(GLenum target, GLuint texture) {
+    if (change(textures[activeUnit], texture)) {
+      glBindTexture(target, texture);
+    }
+  }
+
+  static inline void bindTextureUnit(GLuint unit, GLuint texture) {
+    if (unit >= textureUnits) {
+      glBindTextureUnit(unit, texture);
+      return;
+    }
+    if (change(textures[unit], texture)) {
+      glBindTextureUnit(unit, texture);
+    }
+  }
+
+  static inline void activeTexture(GLuint unit) {
+    if (activeUnit != unit) {
+      activeUnit = unit;
+      glActiveTexture(GL_TEXTURE0 + unit);
+    }
+  }
+
+  // GL unbinds deleted objects itself.
+  static inline void forgetProgram(GLuint program) {
+    if (currentProgram == program) {
+      currentProgram = 0;
+    }
+  }
+  static inline void forgetVertexArray(GLuint array) {
+    if (currentVertexArray == array) {
+      currentVertexArray = 0;
+    }
+  }
+  static inline void forgetTexture(GLuint texture) {
+    for (auto &e : textures) {
+      if (e == texture) {
+        e = 0;
+      }
+    }
+  }
+
+  static inline size_t getIssued() { return issued; }
+  static inline size_t getSkipped() { return skipped; }
+
+private:
+  static inline bool change(GLuint &current, GLuint object) {
+    if (current == object) {
+      skipped++;
+      return false;
+    }
+    current = object;
+    issued++;
+    return true;
+  }
+
+  static inline GLuint currentProgram = 0;
+  static inline GLuint currentVertexArray = 0;
+  static inline GLuint textures[textureUnits]{};
+  static inline GLuint activeUnit = 0;
+
+  static inline size_t issued = 0, skipped = 0;
+};
@@ -1,9 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
-#include <corecrt.h>
 #include <cstddef>
 #include <cstdlib>
+#include <cstring>
 #include <cwchar>
 #include <glm/fwd.hpp>
 #include <iostream>
@@ -11,9 +12,11 @@
 #include <map>
 #include <memory>
 #include <ostream>
+#include <set>
 #include <string>
 #include <string_view>
 #include <tuple>
+#include <vector>
 #include <utility>
 
 #include <GL/glew.h>
@@ -24,269 +27,306 @@
 
 #include <freetype/fttypes.h>
 
+#include "loader.hpp"
+#include "atlas.hpp"
 #include "buffer.hpp"
 #include "freetype/freetype.h"
 #include "ft2wrap.hpp"
+#include "render.hpp"
 #include "shader.hpp"
 #include "texture.hpp"
 #include "traits.hpp"
+#include "utf8.hpp"
 #include "window.hpp"
 
 struct CharacterMetrics {
   CharacterMetrics(FT_ULong charcode, const Ft2Wrap::Face &face)
-      : charcode(charcode), width(face->glyph->bitmap.width),
+      : charcode(charcode), glyphIndex(face->glyph->glyph_index),
+        xScale(face->size->metrics.x_scale),
+        width(face->glyph->bitmap.width),
         height(face->glyph->bitmap.rows), bearingX(face->glyph->bitmap_left),
         bearingY(face->glyph->bitmap_top),
         advanceX(face->glyph->advance.x >> 6),
         advanceY(face->glyph->advance.y >> 6) {}
 
   const FT_ULong charcode;
+  const FT_UInt glyphIndex;
+  const FT_Fixed xScale; // font units to 26.6 pixels as rasterized
 
   const unsigned int width, height;
   const int bearingX, bearingY;
   const int advanceX, advanceY;
 };
 
-class Character : Drawable, Animatable<glm::vec2>, Animatable<wchar_t> {
-private:
-  static inline glm::vec2 uv[4]{{0, 1}, {0, 0}, {1, 0}, {1, 1}};
-
-  static inline std::unique_ptr<VertexArray> array{nullptr};
-  static inline std::unique_ptr<ArrayBuffer<glm::vec3>> textureVerticesBuffer{
-      nullptr};
-  static inline std::unique_ptr<ArrayBuffer<glm::vec2>> textureUVcoordsBuffer{
-      nullptr};
-
-  static inline std::map<std::string, Ft2Wrap::Face> faces{};
-  static inline std::map<FT_ULong, Texture> textureMap{};
-  static inline std::map<std::pair<FT_ULong, FT_F26Dot6>, CharacterMetrics>
-      charactersMetrics{};
+struct Glyph {
+  Glyph(const CharacterMetrics &metrics) : metrics{metrics} {}
 
-  static inline std::string vertexShaderPath{
-      "../shaders/character/character.vert"};
-  static inline std::string fragmentShaderPath{
-      "../shaders/character/character.frag"};
+  CharacterMetrics metrics;
+  GlyphAtlas::Region region;
+};
 
-  static inline void initVertexArray() {
-    array = std::make_unique<VertexArray>();
-  }
+// Per glyph data of an instanced String draw.
+struct GlyphInstance {
+  glm::vec2 offset;
+  glm::vec2 size;
+  glm::vec4 uvRect;
+  glm::vec3 color;
+};
 
-  static inline void innitVerticesBuffer() {
-    if (array) {
-      textureVerticesBuffer = std::make_unique<ArrayBuffer<glm::vec3>>(4);
-      array->vertexArrayVertexBuffer(0, textureVerticesBuffer->getHandle(), 0,
-                                     sizeof(float) * 3);
+// bitmap glyphs are rendered for each size at the window's resolution. sdf
+// glyphs are signed distance fields rendered once at sdfPixels per em, and
+// scaled to any size by the character_sdf shader.
+enum class GlyphMode { bitmap, sdf };
 
-      array->enableVertexArrayAttrib(0);
-      array->vertexArrayAttribFormat(0, 3, GL_FLOAT, GL_FALSE, 0);
-      array->vertexArrayAttribBinding(0, 0);
+// A placed glyph of a String. The bitmap lives in the shared glyph atlas, so
+// a Character owns no GL objects.
+class Character : Animatable<glm::vec2>, Animatable<wchar_t> {
+private:
+  static inline std::map<std::string, Ft2Wrap::Face> faces{};
+  static inline std::map<std::pair<FT_ULong, FT_F26Dot6>, Glyph> glyphs{};
+  static inline std::unique_ptr<GlyphAtlas> atlas{nullptr};
+
+  // A rendered glyph that isn't in the atlas yet.
+  struct Raster {
+    CharacterMetrics metrics;
+    std::vector<unsigned char> pixels; // rows of metrics.width bytes
+  };
+
+  // Touches nothing but face, so it can run on any thread owning the face.
+  static inline Raster rasterize(Ft2Wrap::Face &face, FT_ULong character,
+                                 FT_F26Dot6 size, int resolutionX,
+                                 int resolutionY, GlyphMode mode) {
+    if (mode == GlyphMode::sdf) {
+      face.setPixelSizes(0, sdfPixels);
+    } else {
+      face.setCharSize(size, 0, resolutionX, resolutionY);
     }
-  }
-  static inline void initTextureUVBuffer() {
-    if (array) {
-      textureUVcoordsBuffer = std::make_unique<ArrayBuffer<glm::vec2>>(4);
-      *textureUVcoordsBuffer = uv;
-
-      array->vertexArrayVertexBuffer(1, textureUVcoordsBuffer->getHandle(), 0,
-                                     sizeof(float) * 2);
-      array->enableVertexArrayAttrib(1);
-      array->vertexArrayAttribFormat(1, 2, GL_FLOAT, GL_FALSE, 0);
-      array->vertexArrayAttribBinding(1, 1);
+    auto index = face.getCharIndex(character);
+    auto res = face.loadGlypth(index, FT_LOAD_DEFAULT);
+    // the distance field widens the bitmap and moves its bearing to match
+    res = face.renderGlyph(mode == GlyphMode::sdf ? FT_RENDER_MODE_SDF
+                                                  : FT_RENDER_MODE_NORMAL);
+
+    Raster raster{{character, face}, {}};
+    auto &bitmap = face->glyph->bitmap;
+    raster.pixels.resize(static_cast<size_t>(bitmap.width) * bitmap.rows);
+    for (unsigned int y = 0; y < bitmap.rows; y++) {
+      std::memcpy(raster.pixels.data() + y * bitmap.width,
+                  bitmap.buffer + y * bitmap.pitch, bitmap.width);
     }
+    return raster;
   }
 
-public:
-  Character(std::string fontPath, FT_ULong character, FT_F26Dot6 size,
-            glm::vec3 color, glm::vec2 pos)
-      : pos{pos}, texturePtr{nullptr}, metricsPtr(nullptr), size(size),
-        charcode(character) {
-    if (!array) {
-      initVertexArray();
-    }
+  // Glyphs are cached per size, except distance fields, which serve every
+  // size.
+  static inline std::pair<FT_ULong, FT_F26Dot6>
+  glyphKey(FT_ULong character, FT_F26Dot6 size, GlyphMode mode) {
+    return {character, mode == GlyphMode::sdf ? sdfKey : size};
+  }
 
-    if (!textureVerticesBuffer) {
-      innitVerticesBuffer();
+  static inline Glyph &store(const Raster &raster, FT_F26Dot6 size,
+                             GlyphMode mode) {
+    auto [found, inserted] = glyphs.emplace(
+        glyphKey(raster.metrics.charcode, size, mode), raster.metrics);
+    auto &glyph = found->second;
+    auto &metrics = raster.metrics;
+    if (inserted && metrics.width > 0 && metrics.height > 0) {
+      if (!atlas) {
+        atlas = std::make_unique<GlyphAtlas>();
+      }
+      glyph.region = atlas->insert(metrics.width, metrics.height,
+                                   raster.pixels.data(), metrics.width);
     }
+    return glyph;
+  }
 
-    if (!textureUVcoordsBuffer) {
-      initTextureUVBuffer();
+  static inline Glyph &loadGlyph(Ft2Wrap::Face &face, FT_ULong character,
+                                 FT_F26Dot6 size, GlyphMode mode) {
+    auto found = glyphs.find(glyphKey(character, size, mode));
+    if (found != glyphs.end()) {
+      return found->second;
     }
+    auto [windowWidth, windowHeight] = Window::getSize();
+    return store(rasterize(face, character, size, windowWidth, windowHeight,
+                           mode),
+                 size, mode);
+  }
 
-    Shader vertexShader{vertexShaderPath, GL_VERTEX_SHADER};
-    Shader fragmentShader{fragmentShaderPath, GL_FRAGMENT_SHADER};
-
-    vertexShader.compile();
-    fragmentShader.compile();
-
-    shader = ShaderProgram{vertexShader, fragmentShader};
-
+  static inline Ft2Wrap::Face &getFace(const std::string &fontPath) {
     if (!faces.count(fontPath)) {
       faces.emplace(std::piecewise_construct, std::forward_as_tuple(fontPath),
                     std::forward_as_tuple(fontPath));
     }
+    return faces.at(fontPath);
+  }
 
-    auto &face = faces.at(fontPath);
-    facePtr = &face;
-
-    if (!charactersMetrics.count(std::pair(character, size))) {
-      auto [windowWidth, windowHeight] = Window::getSize();
-      face.setCharSize(size, 0, windowWidth, windowHeight);
-      auto index = face.getCharIndex(character);
-      auto res = face.loadGlypth(index, FT_LOAD_DEFAULT);
-
-      charactersMetrics.emplace(
-          std::piecewise_construct,
-          std::forward_as_tuple(std::pair(character, size)),
-          std::forward_as_tuple(character, face));
-    }
+public:
+  static constexpr int sdfPixels = 48;
+  static constexpr FT_F26Dot6 sdfKey = -1;
 
-    metricsPtr = &charactersMetrics.at(std::pair(character, size));
+  Character(std::string fontPath, FT_ULong character, FT_F26Dot6 size,
+            glm::vec2 pos, GlyphMode mode = GlyphMode::bitmap)
+      : pos{pos}, size(size), charcode(character), mode{mode} {
+    facePtr = &getFace(fontPath);
+    glyphPtr = &loadGlyph(*facePtr, character, size, mode);
+    metricsPtr = &glyphPtr->metrics;
+  }
 
-    calculateVertices();
+  // Distance between baselines in window pixels.
+  auto getLineHeight() {
+    auto [windowWidth, windowHeight] = Window::getSize();
+    return static_cast<int>(lineHeight(*facePtr, size) * windowHeight);
+  }
 
-    if (!textureMap.count(character)) {
-      textureMap.emplace(std::piecewise_construct,
-                         std::forward_as_tuple(character),
-                         std::forward_as_tuple(GL_TEXTURE_2D));
-      if (metricsPtr->width > 0 && metricsPtr->height > 0) {
-        auto &face = faces.at(fontPath);
-        renderToTexture(character, face, textureMap.at(character));
-      }
+  // Window units of a length in pixels of the glyph's bitmap.
+  glm::vec2 toWindow(float x, float y) const {
+    if (mode == GlyphMode::sdf) {
+      return glm::vec2{x, y} * sdfScale(size);
     }
-    texturePtr = &textureMap.at(character);
-
-    shader.use();
-    glUniform3f(4, color.r, color.g, color.b);
+    auto [windowWidth, windowHeight] = Window::getSize();
+    return glm::vec2{x / windowWidth, y / windowHeight};
   }
 
-  auto getLineHeight() { return (*facePtr)->size->metrics.height >> 6; }
-
-  virtual void draw() override {
-    *textureVerticesBuffer = textureVertices;
-
-    array->bind();
-    texturePtr->bind();
-
-    shader.use();
-
-    glUniform1f(2, Window::getAspect());
-    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-
-    texturePtr->unbind();
-    array->unbind();
+  // Distance between baselines in window units. Worked out from the font's
+  // design units: the shared face's size is whatever it was last set to, if
+  // anything, since glyphs are mostly rendered on other threads' faces.
+  static float lineHeight(const std::string &fontPath, FT_F26Dot6 size) {
+    return lineHeight(getFace(fontPath), size);
   }
 
-  virtual void update(glm::vec2 newPos) override {
-    pos = newPos;
-    calculateVertices();
+  // Renders the glyphs of characters that aren't loaded yet on the
+  // Assets::Loader workers, each with its own face of the font, and packs
+  // them into the atlas as the loads finish. Strings created after
+  // Loader::finish() find every glyph ready.
+  static void prewarm(const std::string &fontPath, FT_F26Dot6 size,
+                      std::wstring_view characters,
+                      GlyphMode mode = GlyphMode::bitmap) {
+    constexpr size_t perJob = 16;
+
+    std::vector<FT_ULong> missing;
+    for (auto c : std::set<wchar_t>(characters.begin(), characters.end())) {
+      if (!glyphs.count(glyphKey(c, size, mode))) {
+        missing.push_back(c);
+      }
+    }
+    auto [windowWidth, windowHeight] = Window::getSize();
+    for (size_t first = 0; first < missing.size(); first += perJob) {
+      std::vector<FT_ULong> job(
+          missing.begin() + first,
+          missing.begin() + std::min(first + perJob, missing.size()));
+      Assets::Loader::load(
+          [=] {
+            auto &face = Ft2Wrap::threadFace(fontPath);
+            std::vector<Raster> rasters;
+            for (auto c : job) {
+              rasters.push_back(
+                  rasterize(face, c, size, windowWidth, windowHeight, mode));
+            }
+            return rasters;
+          },
+          [size, mode](std::vector<Raster> rasters) {
+            for (auto &&raster : rasters) {
+              store(raster, size, mode);
+            }
+          });
+    }
   }
 
+  virtual void update(glm::vec2 newPos) override { pos = newPos; }
+
   virtual void update(wchar_t newCharacter) override {
-    auto [windowWidth, windowHeight] = Window::getSize();
-    if (!textureMap.count(newCharacter)) {
-      facePtr->setCharSize(size, 0, windowWidth, windowHeight);
-      auto index = facePtr->getCharIndex(newCharacter);
-      auto res = facePtr->loadGlypth(index, FT_LOAD_DEFAULT);
-      textureMap.emplace(std::piecewise_construct,
-                         std::forward_as_tuple(newCharacter),
-                         std::forward_as_tuple(GL_TEXTURE_2D));
-      renderToTexture(newCharacter, *facePtr, textureMap.at(newCharacter));
+    if (charcode == static_cast<FT_ULong>(newCharacter)) {
+      return;
     }
+    charcode = newCharacter;
+    glyphPtr = &loadGlyph(*facePtr, newCharacter, size, mode);
+    metricsPtr = &glyphPtr->metrics;
+  }
 
-    if (!charactersMetrics.count(std::pair{newCharacter, size})) {
-      charactersMetrics.emplace(std::piecewise_construct,
-                                std::forward_as_tuple(newCharacter, size),
-                                std::forward_as_tuple(newCharacter, *facePtr));
+  // Kerning between this character and next in pixels of the glyph's bitmap.
+  float kerning(const Character &next) const {
+    if (!facePtr->hasKerning() || charcode == L'\n') {
+      return 0;
     }
-
-    texturePtr = &textureMap.at(newCharacter);
-    metricsPtr = &charactersMetrics.at(std::pair{newCharacter, size});
-    calculateVertices();
+    auto kerning =
+        facePtr->getKerning(metricsPtr->glyphIndex,
+                            next.metricsPtr->glyphIndex, FT_KERNING_UNSCALED);
+    return FT_MulFix(kerning.x, metricsPtr->xScale) / 64.0f;
   }
 
-private:
-  void calculateVertices() {
-    auto [windowWidth, windowHeight] = Window::getSize();
-
-    textureVertices[0] = {pos.x, pos.y, 0};
-
-    textureVertices[1] = {
-        pos.x, pos.y + static_cast<float>(metricsPtr->height) / windowHeight,
-        0};
-
-    textureVertices[2] = {
-        pos.x + (static_cast<float>(metricsPtr->width) / windowWidth),
-        pos.y + (static_cast<float>(metricsPtr->height) / windowHeight), 0};
-
-    textureVertices[3] = {
-        pos.x + (static_cast<float>(metricsPtr->width) / windowWidth), pos.y,
-        0};
+  bool visible() const {
+    return charcode != L'\n' && glyphPtr->region.placed;
   }
 
-  void renderToTexture(FT_ULong character, Ft2Wrap::Face &face,
-                       Texture &texture) {
-
-    auto res = face.renderGlyph(FT_RENDER_MODE_NORMAL);
-
-    auto data = face->glyph->bitmap.buffer;
+  size_t getPage() const { return glyphPtr->region.page; }
 
-    texture.pixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    texture.textureStorage2D(1, GL_R8, face->glyph->bitmap.width,
-                             face->glyph->bitmap.rows);
+  GlyphInstance getInstance() const {
+    return GlyphInstance{pos,
+                         toWindow(static_cast<float>(metricsPtr->width),
+                                  static_cast<float>(metricsPtr->height)),
+                         glyphPtr->region.uvRect, glm::vec3{0, 0, 0}};
+  }
 
-    texture.textureSubImage2D(0, 0, 0, face->glyph->bitmap.width,
-                              face->glyph->bitmap.rows, GL_RED,
-                              GL_UNSIGNED_BYTE, data);
+  static Texture &getAtlasPage(size_t page) { return atlas->getPage(page); }
 
-    texture.getnerateTextureMipmap();
+protected:
+  // Window units per pixel of a distance field drawn at size. A bitmap
+  // glyph of size spans size / 64 / 72 * window width pixels per em, and
+  // getInstance divides by the window width, so an em is that many units
+  // whatever the window.
+  static float sdfScale(FT_F26Dot6 size) {
+    return static_cast<float>(size) / (64.0f * 72.0f * sdfPixels);
+  }
 
-    texture.textureParameteri(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    texture.textureParameteri(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    texture.textureParameteri(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    texture.textureParameteri(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  // An em of size is size / 64 / 72 window units in either mode, like
+  // sdfScale.
+  static float lineHeight(const Ft2Wrap::Face &face, FT_F26Dot6 size) {
+    return static_cast<float>(face->height) / face->units_per_EM *
+           static_cast<float>(size) / (64.0f * 72.0f);
   }
 
-protected:
   friend class String;
   CharacterMetrics *metricsPtr;
-  ShaderProgram shader;
+  Glyph *glyphPtr;
   glm::vec2 pos;
-  Texture *texturePtr;
   Ft2Wrap::Face *facePtr;
-  glm::vec3 textureVertices[4];
   FT_F26Dot6 size;
   FT_ULong charcode;
+  GlyphMode mode;
 };
 
+// Submits one instanced draw call per atlas page.
 class String : public Drawable, public Animatable<std::wstring_view> {
 public:
   enum direction { horizonal, vertical };
   enum justify_mode { left, center };
 
+  static inline std::string vertexShaderPath{"character/character.vert"};
+  static inline std::string fragmentShaderPath{"character/character.frag"};
+  static inline std::string sdfFragmentShaderPath{
+      "character/character_sdf.frag"};
+
+  // Mode of Strings constructed without one.
+  static inline GlyphMode defaultMode = GlyphMode::bitmap;
+
   String(std::string fontPath, std::wstring str, FT_F26Dot6 size,
          glm::vec3 color, glm::vec2 pos, justify_mode justity = left,
-         direction d = horizonal)
+         direction d = horizonal, GlyphMode mode = defaultMode)
       : str{str}, d{d}, pos{pos}, fontPath{fontPath}, size{size}, color{color},
-        jmode(justity) {
-    auto [windowWidth, windowHeight] = Window::getSize();
+        jmode(justity), mode{mode} {
     characters.reserve(str.size());
     for (auto &&c : str) {
-      characters.emplace_back(fontPath, c, size, color, glm::vec2{0, 0});
+      characters.emplace_back(fontPath, c, size, glm::vec2{0, 0}, mode);
     }
 
     if (d == horizonal) {
-      characters.reserve(str.size());
-      for (int i = 0; i < characters.size(); i++) {
-        characters[i].update(str[i]);
-      }
-
       calculateCharacterHolizonalLayout();
     }
+    updateInstances();
   }
 
   virtual void update(std::wstring_view newStr) override {
     if (str != newStr) {
-      auto [windowWidth, windowHeight] = Window::getSize();
       if (newStr.size() > characters.size()) {
         characters.reserve(newStr.size());
         for (int i = 0; i < characters.size(); i++) {
@@ -294,78 +334,244 @@ public:
         }
 
         for (int i = characters.size(); i < newStr.size(); i++) {
-          characters.emplace_back(fontPath, newStr[i], size, color,
-                                  glm::vec2{0, 0});
-        }
-
-        if (d == horizonal) {
-          calculateCharacterHolizonalLayout();
+          characters.emplace_back(fontPath, newStr[i], size, glm::vec2{0, 0},
+                                  mode);
         }
       } else if (newStr.size() <= characters.size()) {
         characters.erase(characters.begin() + newStr.size(), characters.end());
         for (int i = 0; i < newStr.size(); i++) {
           characters[i].update(newStr[i]);
         }
-        if (d == horizonal) {
-          calculateCharacterHolizonalLayout();
-        }
       }
+      str = newStr;
+
+      if (d == horizonal) {
+        calculateCharacterHolizonalLayout();
+      }
+      updateInstances();
     }
-    str = newStr;
+  }
+
+  // update() with UTF-8 text.
+  void update(std::string_view utf8) {
+    Utf8::decode(utf8, decoded);
+    update(std::wstring_view{decoded});
   }
 
   virtual void draw() override {
-    for (auto &&c : characters) {
-      c.draw();
+    if (ranges.empty()) {
+      return;
+    }
+
+    for (auto &&range : ranges) {
+      auto &page = Character::getAtlasPage(range.page);
+      RenderQueue::submit(
+          {RenderQueue::overlay, *shader, page.getHandle(), array.getHandle()},
+          "String", this,
+          [](void *object, const RenderQueue::Args &args) {
+            auto &self = *static_cast<String *>(object);
+            self.array.bind();
+            self.shader->use();
+            static_cast<Texture *>(args.resource)->bind();
+            glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4,
+                                              args.count, args.first);
+          },
+          {range.first, range.count, &page});
     }
   }
 
 private:
-  void calculateCharacterHolizonalLayout() {
-    glm::vec2 nextPos{0, 0};
-    auto [windowWidth, windowHeight] = Window::getSize();
+  // Pen positions of a text's characters in pixels of their glyphs: x from
+  // the start of the line, kerning included, and y the line number. Shared by
+  // every String drawing the text in the same font, size and mode.
+  struct Layout {
+    std::wstring text;
+    std::vector<glm::vec2> pens;
+    std::vector<float> lineWidths;
+  };
+
+  using LayoutKey =
+      std::tuple<std::string, FT_F26Dot6, GlyphMode, std::wstring>;
+
+  // Cached layouts are dropped all at once past this many.
+  static constexpr size_t maxLayouts = 256;
+  static inline std::map<LayoutKey, std::shared_ptr<const Layout>> layouts;
+
+  struct DrawRange {
+    size_t page;
+    GLsizei first, count;
+  };
+
+  // Collects the visible glyphs grouped by atlas page and uploads them as
+  // one instance buffer. Only the instances that differ from the last upload
+  // are written.
+  void updateInstances() {
+    std::vector<const Character *> visible;
+    visible.reserve(characters.size());
+    for (auto &&c : characters) {
+      if (c.visible()) {
+        visible.push_back(&c);
+      }
+    }
+    std::stable_sort(visible.begin(), visible.end(),
+                     [](const Character *a, const Character *b) {
+                       return a->getPage() < b->getPage();
+                     });
+
+    instances.clear();
+    ranges.clear();
+    for (auto *c : visible) {
+      if (ranges.empty() || ranges.back().page != c->getPage()) {
+        ranges.push_back(
+            DrawRange{c->getPage(), static_cast<GLsizei>(instances.size()), 0});
+      }
+      instances.push_back(c->getInstance());
+      instances.back().color = color;
+      ranges.back().count++;
+    }
+
+    if (instances.empty()) {
+      return;
+    }
+    if (!instanceBuffer || instanceCapacity < instances.size()) {
+      reserveInstances(std::max<size_t>(instances.size(), 16));
+      uploaded.clear();
+    }
+
+    auto same = [](const GlyphInstance &a, const GlyphInstance &b) {
+      return std::memcmp(&a, &b, sizeof(GlyphInstance)) == 0;
+    };
+    size_t first = 0, last = instances.size();
+    auto common = std::min(instances.size(), uploaded.size());
+    while (first < common && same(instances[first], uploaded[first])) {
+      first++;
+    }
+    if (instances.size() <= uploaded.size()) {
+      while (last > first && same(instances[last - 1], uploaded[last - 1])) {
+        last--;
+      }
+    }
+    if (first < last) {
+      instanceBuffer->namedBufferSubData(sizeof(GlyphInstance) * first,
+                                         sizeof(GlyphInstance) * (last - first),
+                                         instances.data() + first);
+    }
+    uploaded = instances;
+  }
 
-    if (jmode == left) {
-      nextPos = pos;
-    } else if (jmode == center) {
-      auto [windowWidth, windowHeight] = Window::getSize();
-      float stringWidth = 0;
+  void reserveInstances(size_t capacity) {
+    instanceCapacity = capacity;
+    instanceBuffer = std::make_unique<ArrayBuffer<GlyphInstance>>(capacity);
+
+    array.vertexArrayVertexBuffer(0, instanceBuffer->getHandle(), 0,
+                                  sizeof(GlyphInstance));
+    array.vertexArrayBindingDivisor(0, 1);
+
+    array.enableVertexArrayAttrib(0);
+    array.enableVertexArrayAttrib(1);
+    array.enableVertexArrayAttrib(2);
+    array.enableVertexArrayAttrib(3);
+
+    array.vertexArrayAttribFormat(0, 2, GL_FLOAT, GL_FALSE,
+                                  offsetof(GlyphInstance, offset));
+    array.vertexArrayAttribFormat(1, 2, GL_FLOAT, GL_FALSE,
+                                  offsetof(GlyphInstance, size));
+    array.vertexArrayAttribFormat(2, 4, GL_FLOAT, GL_FALSE,
+                                  offsetof(GlyphInstance, uvRect));
+    array.vertexArrayAttribFormat(3, 3, GL_FLOAT, GL_FALSE,
+                                  offsetof(GlyphInstance, color));
+
+    array.vertexArrayAttribBinding(0, 0);
+    array.vertexArrayAttribBinding(1, 0);
+    array.vertexArrayAttribBinding(2, 0);
+    array.vertexArrayAttribBinding(3, 0);
+  }
+
+  // The layout of str from the cache, or else worked out from the current
+  // one: pens before the first character that differs are kept.
+  std::shared_ptr<const Layout> findLayout() {
+    LayoutKey key{fontPath, size, mode, str};
+    auto found = layouts.find(key);
+    if (found != layouts.end()) {
+      return found->second;
+    }
 
-      float stringHeight =
-          static_cast<float>(
-              Character::faces.at(fontPath)->size->metrics.height >> 6) /
-          windowHeight;
+    auto next = std::make_shared<Layout>();
+    next->text = str;
+    size_t kept = 0;
+    if (layout) {
+      auto &text = layout->text;
+      kept = std::mismatch(text.begin(), text.end(), str.begin(), str.end())
+                 .first -
+             text.begin();
+      next->pens.assign(layout->pens.begin(), layout->pens.begin() + kept);
+      next->lineWidths = layout->lineWidths;
+    }
 
-      for (auto &&c : characters) {
-        stringWidth += static_cast<float>(c.metricsPtr->advanceX) / windowWidth;
+    auto &pens = next->pens;
+    for (size_t i = kept; i < characters.size(); i++) {
+      if (i == 0) {
+        pens.push_back({0, 0});
+      } else if (characters[i - 1].charcode == L'\n') {
+        pens.push_back({0, pens[i - 1].y + 1});
+      } else {
+        auto &previous = characters[i - 1];
+        pens.push_back(
+            {pens[i - 1].x + previous.metricsPtr->advanceX +
+                 previous.kerning(characters[i]),
+             pens[i - 1].y});
       }
+    }
 
-      nextPos =
-          glm::vec2{pos.x - (stringWidth / 2), pos.y - (stringHeight / 4)};
+    // only the lines from the last kept character on can have changed
+    auto &widths = next->lineWidths;
+    widths.resize(pens.empty() ? 0 : static_cast<size_t>(pens.back().y) + 1);
+    for (size_t i = kept > 0 ? kept - 1 : 0; i < pens.size(); i++) {
+      auto &c = characters[i];
+      auto line = static_cast<size_t>(pens[i].y);
+      widths[line] = pens[i].x;
+      if (c.charcode != L'\n') {
+        widths[line] += c.metricsPtr->advanceX;
+      }
     }
 
-    for (auto &&c : characters) {
+    if (layouts.size() >= maxLayouts) {
+      layouts.clear();
+    }
+    layouts.emplace(std::move(key), next);
+    return next;
+  }
+
+  void calculateCharacterHolizonalLayout() {
+    layout = findLayout();
+
+    auto lineHeight = Character::lineHeight(fontPath, size);
+    glm::vec2 origin = pos;
+    if (jmode == center && !characters.empty()) {
+      auto &widths = layout->lineWidths;
+      auto width = *std::max_element(widths.begin(), widths.end());
+      origin = pos - glm::vec2{characters[0].toWindow(width, 0).x / 2,
+                               lineHeight / 4};
+    }
 
+    for (size_t i = 0; i < characters.size(); i++) {
+      auto &c = characters[i];
       if (c.charcode == L'\n') {
-        auto lineHeight =
-            Character::faces.at(fontPath)->size->metrics.height >> 6;
-        nextPos =
-            glm::vec2{pos.x, nextPos.y - ((float)lineHeight / windowHeight)};
         continue;
       }
 
-      c.update(glm::vec2{
-          nextPos.x + ((float)c.metricsPtr->bearingX / windowWidth),
-          nextPos.y -
-              (((float)c.metricsPtr->height - (float)c.metricsPtr->bearingY) /
-               windowHeight)});
-
-      nextPos = glm::vec2{
-          nextPos.x + (float)c.metricsPtr->advanceX / windowWidth, nextPos.y};
+      auto &metrics = *c.metricsPtr;
+      auto &pen = layout->pens[i];
+      c.update(origin - glm::vec2{0, pen.y * lineHeight} +
+               c.toWindow(pen.x + static_cast<float>(metrics.bearingX),
+                          static_cast<float>(metrics.bearingY) -
+                              static_cast<float>(metrics.height)));
     }
   }
 
   std::wstring str;
+  std::wstring decoded; // update(std::string_view)'s buffer
+  std::shared_ptr<const Layout> layout;
   std::vector<Character> characters;
   glm::vec2 pos;
   std::string fontPath;
@@ -373,4 +579,16 @@ private:
   glm::vec3 color;
   direction d;
   justify_mode jmode;
+  GlyphMode mode;
+
+  std::shared_ptr<ShaderProgram> shader{ShaderProgram::get(
+      {{vertexShaderPath, GL_VERTEX_SHADER},
+       {mode == GlyphMode::sdf ? sdfFragmentShaderPath : fragmentShaderPath,
+        GL_FRAGMENT_SHADER}})};
+  VertexArray array;
+  std::unique_ptr<ArrayBuffer<GlyphInstance>> instanceBuffer{nullptr};
+  size_t instanceCapacity = 0;
+  std::vector<GlyphInstance> instances;
+  std::vector<GlyphInstance> uploaded; // what instanceBuffer holds
+  std::vector<DrawRange> ranges;
 };
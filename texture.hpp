@@ -4,6 +4,7 @@
 #include <GLFW/glfw3.h>
 
 #include "handle.hpp"
+#include "state.hpp"
 #include "traits.hpp"
 
 class Texture : public glObject, public Bindable {
@@ -12,8 +13,8 @@ public:
 
   virtual const GLuint getHandle() override { return handle; }
 
-  virtual void bind() override { glBindTexture(target, handle); }
-  virtual void unbind() override { glBindTexture(target, 0); }
+  virtual void bind() override { GLState::bindTexture(target, handle); }
+  virtual void unbind() override { GLState::bindTexture(target, 0); }
 
   void textureParameteri(GLenum pname, GLenum param) {
     glTextureParameteri(handle, pname, param);
@@ -31,9 +32,14 @@ public:
                         type, pixels);
   }
 
+  void clearTexImage(GLint level, GLenum format, GLenum type,
+                     const void *data) {
+    glClearTexImage(handle, level, format, type, data);
+  }
+
   void getnerateTextureMipmap() { glGenerateTextureMipmap(handle); }
 
-  void bindTextureUnit(GLuint unit) { glBindTextureUnit(unit, handle); }
+  void bindTextureUnit(GLuint unit) { GLState::bindTextureUnit(unit, handle); }
 
   void pixelStorei(GLenum pname, GLint param) { glPixelStorei(pname, param); }
 
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Hands the latest value from one writer thread to one reader thread without
+// locks or waiting. The writer fills back() and publishes it; the reader
+// takes whatever was published last, and values it was too slow to see are
+// dropped. Each side owns one slot and the third is swapped between them.
+template <typename T> class TripleBuffer {
+public:
+  // Writer: the slot to fill before publish().
+  T &back() { return slots[backIndex]; }
+
+  void publish() {
+    backIndex =
+        middle.exchange(backIndex | fresh, std::memory_order_acq_rel) & index;
+  }
+
+  // Reader: the value published last. It stays valid and unchanged until the
+  // next acquire().
+  const T &acquire() {
+    if (middle.load(std::memory_order_relaxed) & fresh) {
+      frontIndex =
+          middle.exchange(frontIndex, std::memory_order_acq_rel) & index;
+    }
+    return slots[frontIndex];
+  }
+
+private:
+  static constexpr uint8_t index = 3, fresh = 4;
+
+  T slots[3]{};
+  alignas(64) std::atomic<uint8_t> middle{1};
+  alignas(64) uint8_t backIndex = 0;  // writer's
+  alignas(64) uint8_t frontIndex = 2; // reader's
+};
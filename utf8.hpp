@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// UTF-8 to the wide strings Strings draw. Runs of ASCII are widened eight
+// bytes at a time; malformed sequences, overlong forms and surrogates decode
+// to U+FFFD. Where wchar_t is 16 bits wide, code points above the BMP become
+// surrogate pairs.
+
+namespace Utf8 {
+
+static constexpr char32_t replacement = 0xFFFD;
+
+inline wchar_t *append(wchar_t *out, char32_t codepoint) {
+  if constexpr (sizeof(wchar_t) == 2) {
+    if (codepoint > 0xFFFF) {
+      codepoint -= 0x10000;
+      *out++ = static_cast<wchar_t>(0xD800 + (codepoint >> 10));
+      *out++ = static_cast<wchar_t>(0xDC00 + (codepoint & 0x3FF));
+      return out;
+    }
+  }
+  *out++ = static_cast<wchar_t>(codepoint);
+  return out;
+}
+
+// Replaces out with the decoded text, reusing its storage.
+inline void decode(std::string_view text, std::wstring &out) {
+  // never more wide characters than bytes
+  out.resize(text.size());
+  auto *written = out.data();
+
+  auto *at = reinterpret_cast<const uint8_t *>(text.data());
+  auto *end = at + text.size();
+  while (at < end) {
+    if (end - at >= 8) {
+      uint64_t block;
+      std::memcpy(&block, at, 8);
+      if ((block & 0x8080808080808080u) == 0) {
+        for (int i = 0; i < 8; i++) {
+          written[i] = static_cast<wchar_t>(at[i]);
+        }
+        written += 8;
+        at += 8;
+        continue;
+      }
+    }
+
+    uint8_t lead = *at++;
+    if (lead < 0x80) {
+      *written++ = static_cast<wchar_t>(lead);
+      continue;
+    }
+
+    int length = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : -1;
+    if (length < 0 || lead > 0xF4 || end - at < length) {
+      written = append(written, replacement);
+      continue;
+    }
+    char32_t codepoint = lead & (0x3F >> length);
+    int i = 0;
+    for (; i < length && (at[i] & 0xC0) == 0x80; i++) {
+      codepoint = codepoint << 6 | (at[i] & 0x3F);
+    }
+    if (i < length) {
+      // the byte that broke the sequence starts the next one
+      at += i;
+      written = append(written, replacement);
+      continue;
+    }
+    at += length;
+
+    static constexpr char32_t smallest[]{0, 0x80, 0x800, 0x10000};
+    if (codepoint < smallest[length] || codepoint > 0x10FFFF ||
+        (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+      codepoint = replacement;
+    }
+    written = append(written, codepoint);
+  }
+  out.resize(written - out.data());
+}
+
+inline std::wstring decode(std::string_view text) {
+  std::wstring out;
+  decode(text, out);
+  return out;
+}
+
+} // namespace Utf8
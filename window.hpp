@@ -1,6 +1,9 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <iostream>
+#include <tuple>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -8,8 +11,21 @@
 
 class Window {
 private:
-  static inline int width;
-  static inline int height;
+  // width and height packed into one value, so the simulation and render
+  // threads never read half of a resize
+  static inline std::atomic<uint64_t> size{0};
+  // the framebuffer's size in pixels, applied to the viewport by the thread
+  // that has the context
+  static inline std::atomic<uint64_t> framebuffer{0};
+  static inline uint64_t viewport{0};
+
+  static constexpr uint64_t pack(int width, int height) {
+    return static_cast<uint64_t>(static_cast<uint32_t>(width)) << 32 |
+           static_cast<uint32_t>(height);
+  }
+  static constexpr std::tuple<int, int> unpack(uint64_t packed) {
+    return {static_cast<int>(packed >> 32), static_cast<int>(packed)};
+  }
 
 public:
   static inline GLFWwindow *create(int width, int height,
@@ -18,23 +34,35 @@ public:
     setSize(width, height);
     return glfwCreateWindow(width, height, title.data(), monitor, share);
   }
+  // Runs on the thread polling events, which needn't have the context.
   static inline void onResize(GLFWwindow *const window, int newWidth,
                               int newHeight) {
+    if (newWidth <= 0 || newHeight <= 0) {
+      return; // minimized; keep the last size
+    }
     int fbWidth, fbHeight;
     glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
-    glViewport(0, 0, fbWidth, fbHeight);
-    glOrtho(0.0, width, height, 0.0, -1.0, 1.0);
-    width = newWidth;
-    height = newHeight;
+    framebuffer = pack(fbWidth, fbHeight);
+    size = pack(newWidth, newHeight);
+  }
+
+  // Applies the last resize to the viewport. Call with the context current.
+  static inline void updateViewport() {
+    auto latest = framebuffer.load();
+    if (latest != viewport) {
+      auto [fbWidth, fbHeight] = unpack(latest);
+      glViewport(0, 0, fbWidth, fbHeight);
+      viewport = latest;
+    }
   }
 
   static inline void setSize(int width, int height) {
-    Window::width = width;
-    Window::height = height;
+    size = pack(width, height);
   }
 
   static inline float getAspect() {
+    auto [width, height] = getSize();
     return static_cast<float>(width) / static_cast<float>(height);
   }
-  static inline std::tuple<int, int> getSize() { return {width, height}; }
+  static inline std::tuple<int, int> getSize() { return unpack(size); }
 };